@@ -0,0 +1,14 @@
+#ifndef GRAPH_BENCH_H_
+#define GRAPH_BENCH_H_
+
+#include <chrono>
+
+// Timing shared by the micro benchmarks. Each benchmark keeps its own report
+// function, since the rates it prints differ.
+typedef std::chrono::steady_clock Clock;
+
+inline double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+#endif
@@ -0,0 +1,171 @@
+// Compares the binary record codec with the json11 encoding that was used on
+// the storage path before, on a synthetic graph of works and events. The view
+// rows decode without copying, all fields and only the ones li w prints.
+//
+//   codec_bench [works] [events_per_work]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "codec.h"
+#include "graph.h"
+#include "json11.hpp"
+#include "util.h"
+
+static void report(const char *name, size_t records, size_t bytes, double seconds) {
+  std::printf("%-14s %10.0f records/s %10.1f MB/s %10zu bytes\n",
+              name, records / seconds, bytes / seconds / 1048576.0, bytes);
+}
+
+static std::string jsonEvent(const Event &event) {
+  char buf[255];
+  formatTime(buf, 255, event.createdAt);
+  return json11::Json(json11::Json::object{
+          {"id",         event.id},
+          {"content",    event.content},
+          {"created_at", std::string(buf)}}).dump();
+}
+
+static void parseJsonEvent(const std::string &data, Event *event) {
+  std::string err;
+  auto items = json11::Json::parse(data, err).object_items();
+  event->id = items.find("id")->second.int_value();
+  event->content = items.find("content")->second.string_value();
+  parseTime(items.find("created_at")->second.string_value().c_str(), &event->createdAt);
+}
+
+static std::string jsonWork(const Work &work) {
+  char buf[255];
+  formatTime(buf, 255, work.updatedAt);
+  json11::Json::array related_people;
+  for (auto &it: work.related_people) {
+    related_people.push_back(it);
+  }
+  return json11::Json(json11::Json::object{
+          {"id",             work.id},
+          {"content",        work.content},
+          {"status",         work.status},
+          {"priority",       work.priority},
+          {"updated_at",     std::string(buf)},
+          {"related_people", related_people}}).dump();
+}
+
+static void parseJsonWork(const std::string &data, Work *work) {
+  std::string err;
+  auto items = json11::Json::parse(data, err).object_items();
+  work->id = items.find("id")->second.int_value();
+  work->content = items.find("content")->second.string_value();
+  for (auto &it: items.find("related_people")->second.array_items()) {
+    work->related_people.push_back(it.string_value());
+  }
+  work->status = Status(items.find("status")->second.int_value());
+  work->priority = items.find("priority")->second.int_value();
+  parseTime(items.find("updated_at")->second.string_value().c_str(), &work->updatedAt);
+}
+
+int main(int argc, char **argv) {
+  int works = argc > 1 ? std::atoi(argv[1]) : 2000;
+  int events = argc > 2 ? std::atoi(argv[2]) : 25;
+
+  int64_t now = nowMicros();
+  std::vector<Work> ws;
+  for (int i = 1; i <= works; i++) {
+    Work w = Work{};
+    w.id = i;
+    w.content = "work content number " + std::to_string(i) + " 包含中文";
+    w.related_people = {"alice", "bob"};
+    w.status = kDoing;
+    w.priority = i % 5;
+    w.updatedAt = now;
+    for (int j = 1; j <= events; j++) {
+      w.events.push_back(Event{j, "event content " + std::to_string(j) + " for work " + std::to_string(i), now});
+    }
+    ws.push_back(w);
+  }
+  size_t records = works * (events + 1);
+
+  std::vector<std::string> json;
+  json.reserve(records);
+  auto start = Clock::now();
+  size_t bytes = 0;
+  for (auto &w: ws) {
+    json.push_back(jsonWork(w));
+    bytes += json.back().size();
+    for (auto &e: w.events) {
+      json.push_back(jsonEvent(e));
+      bytes += json.back().size();
+    }
+  }
+  report("json encode", records, bytes, secondsSince(start));
+
+  start = Clock::now();
+  size_t k = 0;
+  for (int i = 0; i < works; i++) {
+    Work w = Work{};
+    parseJsonWork(json[k++], &w);
+    for (int j = 0; j < events; j++) {
+      Event e = Event{};
+      parseJsonEvent(json[k++], &e);
+    }
+  }
+  report("json decode", records, bytes, secondsSince(start));
+
+  std::vector<std::string> binary;
+  binary.reserve(records);
+  start = Clock::now();
+  bytes = 0;
+  for (auto &w: ws) {
+    binary.push_back(std::string());
+    EncodeWork(w, &binary.back());
+    bytes += binary.back().size();
+    for (auto &e: w.events) {
+      binary.push_back(std::string());
+      EncodeEvent(e, &binary.back());
+      bytes += binary.back().size();
+    }
+  }
+  report("binary encode", records, bytes, secondsSince(start));
+
+  start = Clock::now();
+  k = 0;
+  for (int i = 0; i < works; i++) {
+    Work w = Work{};
+    DecodeWork(binary[k++], &w);
+    for (int j = 0; j < events; j++) {
+      Event e = Event{};
+      DecodeEvent(binary[k++], &e);
+    }
+  }
+  report("binary decode", records, bytes, secondsSince(start));
+
+  start = Clock::now();
+  k = 0;
+  WorkView wv;
+  EventView ev;
+  size_t checksum = 0;
+  for (int i = 0; i < works; i++) {
+    DecodeWorkView(binary[k++], &wv);
+    checksum += wv.content.size();
+    for (int j = 0; j < events; j++) {
+      DecodeEventView(binary[k++], &ev);
+      checksum += ev.id;
+    }
+  }
+  report("view decode", records, bytes, secondsSince(start));
+
+  start = Clock::now();
+  k = 0;
+  for (int i = 0; i < works; i++) {
+    DecodeWorkView(binary[k++], &wv, kWorkFieldId | kWorkFieldContent | kWorkFieldStatus | kWorkFieldPriority |
+                                     kWorkFieldUpdatedAt);
+    checksum -= wv.content.size();
+    for (int j = 0; j < events; j++) {
+      DecodeEventView(binary[k++], &ev, kEventFieldId);
+      checksum -= ev.id;
+    }
+  }
+  report("view projected", records, bytes, secondsSince(start));
+  return checksum == 0 ? 0 : 1;
+}
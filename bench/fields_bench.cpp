@@ -0,0 +1,254 @@
+// Compares the codecs generated from the field descriptors in fields.h with
+// the hand-written code they replaced: json11 objects for JSON encoding,
+// Json::parse with key lookups for JSON decoding, and per-field tag writes and
+// switches for the binary format.
+//
+//   fields_bench [works] [events_per_work] [rounds]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "codec.h"
+#include "graph.h"
+#include "json11.hpp"
+#include "json_records.h"
+#include "util.h"
+
+static void report(const char *name, size_t records, double seconds) {
+  std::printf("%-22s %12.0f records/s\n", name, records / seconds);
+}
+
+static std::string timeString(int64_t us) {
+  char buf[255];
+  formatTime(buf, 255, us);
+  return buf;
+}
+
+static json11::Json::object handJsonWork(const Work &work) {
+  json11::Json::array related_people;
+  for (auto &it: work.related_people) {
+    related_people.push_back(it);
+  }
+  return json11::Json::object{
+          {"id",             work.id},
+          {"content",        work.content},
+          {"status",         work.status},
+          {"priority",       work.priority},
+          {"updated_at",     timeString(work.updatedAt)},
+          {"related_people", related_people}};
+}
+
+static json11::Json::object handJsonEvent(const Event &event) {
+  return json11::Json::object{
+          {"id",         event.id},
+          {"content",    event.content},
+          {"created_at", timeString(event.createdAt)}};
+}
+
+static void handParseWork(const std::string &data, Work *work) {
+  std::string err;
+  auto items = json11::Json::parse(data, err).object_items();
+  work->id = items["id"].int_value();
+  work->content = items["content"].string_value();
+  for (auto &it: items["related_people"].array_items()) {
+    work->related_people.push_back(it.string_value());
+  }
+  work->status = Status(items["status"].int_value());
+  work->priority = items["priority"].int_value();
+  parseTime(items["updated_at"].string_value().c_str(), &work->updatedAt);
+}
+
+static void putTag(std::string *dst, int field, WireType type) {
+  PutVarint64(dst, (static_cast<uint64_t>(field) << 3) | type);
+}
+
+static void putInt(std::string *dst, int field, int64_t v) {
+  putTag(dst, field, kWireVarint);
+  PutVarint64(dst, (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+}
+
+static void putString(std::string *dst, int field, const std::string &v) {
+  putTag(dst, field, kWireBytes);
+  PutLengthPrefixed(dst, v);
+}
+
+static void handEncodeWork(const Work &work, std::string *dst) {
+  dst->push_back(kRecordVersion);
+  putInt(dst, 1, work.id);
+  putString(dst, 2, work.content);
+  for (auto &it: work.related_people) {
+    putString(dst, 3, it);
+  }
+  putInt(dst, 4, work.status);
+  putInt(dst, 5, work.priority);
+  putInt(dst, 6, work.updatedAt);
+}
+
+static bool handDecodeWorkView(leveldb::Slice input, WorkView *work) {
+  work->id = 0;
+  work->content.clear();
+  work->related_people.clear();
+  work->status = kStart;
+  work->priority = 0;
+  work->updatedAt = 0;
+  if (!IsBinaryRecord(input)) {
+    return false;
+  }
+  input.remove_prefix(1);
+  while (!input.empty()) {
+    uint64_t tag, v = 0;
+    leveldb::Slice bytes;
+    if (!GetVarint64(&input, &tag)) {
+      return false;
+    }
+    if ((tag & 7) == kWireVarint ? !GetVarint64(&input, &v) : !GetLengthPrefixed(&input, &bytes)) {
+      return false;
+    }
+    int64_t i = static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+    switch (tag >> 3) {
+      case 1:
+        work->id = static_cast<int>(i);
+        break;
+      case 2:
+        work->content = bytes;
+        break;
+      case 3:
+        work->related_people.push_back(bytes);
+        break;
+      case 4:
+        work->status = static_cast<Status>(i);
+        break;
+      case 5:
+        work->priority = static_cast<int>(i);
+        break;
+      case 6:
+        work->updatedAt = i;
+        break;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int works = argc > 1 ? std::atoi(argv[1]) : 2000;
+  int events = argc > 2 ? std::atoi(argv[2]) : 25;
+  int rounds = argc > 3 ? std::atoi(argv[3]) : 5;
+
+  int64_t now = nowMicros();
+  Graph graph;
+  graph.id = 1;
+  graph.name = "bench";
+  for (int i = 1; i <= works; i++) {
+    Work w = Work{};
+    w.id = i;
+    w.content = "work content number " + std::to_string(i) + " 包含中文";
+    w.related_people = {"alice", "bob"};
+    w.status = kDoing;
+    w.priority = i % 5;
+    w.updatedAt = now;
+    for (int j = 1; j <= events; j++) {
+      w.events.push_back(Event{j, "event content " + std::to_string(j) + " for work " + std::to_string(i), now});
+    }
+    graph.works["work-" + std::to_string(i)] = w;
+  }
+  size_t records = works * (events + 1) * static_cast<size_t>(rounds);
+
+  auto start = Clock::now();
+  size_t bytes = 0;
+  for (int r = 0; r < rounds; r++) {
+    json11::Json::object ws;
+    for (auto &it: graph.works) {
+      json11::Json::object w = handJsonWork(it.second);
+      json11::Json::array es;
+      for (auto &e: it.second.events) {
+        es.push_back(handJsonEvent(e));
+      }
+      w["events"] = es;
+      ws[it.first] = w;
+    }
+    bytes += json11::Json(json11::Json::object{{"id", graph.id}, {"name", graph.name}, {"works", ws},
+                                               {"relations", json11::Json::object{}}}).dump().size();
+  }
+  report("json encode hand", records, secondsSince(start));
+
+  start = Clock::now();
+  for (int r = 0; r < rounds; r++) {
+    std::string out;
+    DumpGraphJson(graph, &out);
+    bytes += out.size();
+  }
+  report("json encode fields", records, secondsSince(start));
+  std::printf("%-22s %12zu bytes per round\n", "json output", bytes / rounds);
+
+  std::vector<std::string> json;
+  std::vector<std::string> binary;
+  for (auto &it: graph.works) {
+    json.push_back(json11::Json(handJsonWork(it.second)).dump());
+    binary.push_back(std::string());
+    EncodeWork(it.second, &binary.back());
+  }
+  size_t workRecords = json.size() * rounds;
+
+  start = Clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (auto &it: json) {
+      Work w = Work{};
+      handParseWork(it, &w);
+    }
+  }
+  report("json decode hand", workRecords, secondsSince(start));
+
+  start = Clock::now();
+  std::string err;
+  for (int r = 0; r < rounds; r++) {
+    for (auto &it: json) {
+      Work w = Work{};
+      ParseWorkJson(it, &w, &err);
+    }
+  }
+  report("json decode fields", workRecords, secondsSince(start));
+
+  std::string out;
+  start = Clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (auto &it: graph.works) {
+      out.clear();
+      handEncodeWork(it.second, &out);
+    }
+  }
+  report("binary encode hand", workRecords, secondsSince(start));
+  std::string expected = out;
+
+  start = Clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (auto &it: graph.works) {
+      out.clear();
+      EncodeWork(it.second, &out);
+    }
+  }
+  report("binary encode fields", workRecords, secondsSince(start));
+
+  WorkView view;
+  size_t checksum = 0;
+  start = Clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (auto &it: binary) {
+      handDecodeWorkView(it, &view);
+      checksum += view.content.size();
+    }
+  }
+  report("binary decode hand", workRecords, secondsSince(start));
+
+  start = Clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (auto &it: binary) {
+      DecodeWorkView(it, &view);
+      checksum -= view.content.size();
+    }
+  }
+  report("binary decode fields", workRecords, secondsSince(start));
+  // The generated codecs must produce what the hand-written ones did.
+  return checksum == 0 && out == expected ? 0 : 1;
+}
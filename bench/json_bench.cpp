@@ -0,0 +1,191 @@
+// Compares decoding a legacy graph blob through a json11 DOM, copying the
+// fields out afterwards, with the same through a reused arena-backed
+// json11::JsonDocument, and with the SAX decoder in json_records.h that fills
+// the structs directly. Allocations are counted with a replaced global
+// operator new.
+//
+//   json_bench [works] [events_per_work] [rounds]
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "bench.h"
+#include "graph.h"
+#include "json11.hpp"
+#include "json_records.h"
+#include "util.h"
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+  allocations++;
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+
+static void report(const char *name, int rounds, size_t bytes, size_t allocs, double seconds) {
+  std::printf("%-12s %10.1f MB/s %10.1f docs/s %12zu allocations/doc\n",
+              name, bytes * rounds / seconds / 1048576.0, rounds / seconds, allocs / rounds);
+}
+
+static std::string legacyGraph(int works, int events) {
+  char buf[255];
+  formatTime(buf, 255, nowMicros());
+  json11::Json::object ws;
+  for (int i = 1; i <= works; i++) {
+    json11::Json::array es;
+    for (int j = 1; j <= events; j++) {
+      es.push_back(json11::Json::object{
+              {"id",         j},
+              {"content",    "event content " + std::to_string(j) + " for work " + std::to_string(i)},
+              {"created_at", std::string(buf)}});
+    }
+    ws["work-" + std::to_string(i)] = json11::Json::object{
+            {"id",             i},
+            {"content",        "work content number " + std::to_string(i) + " 包含中文"},
+            {"status",         1},
+            {"priority",       i % 5},
+            {"updated_at",     std::string(buf)},
+            {"related_people", json11::Json::array{"alice", "bob"}},
+            {"events",         es}};
+  }
+  return json11::Json(json11::Json::object{
+          {"id",        1},
+          {"name",      "bench"},
+          {"works",     ws},
+          {"relations", json11::Json::object{}}}).dump();
+}
+
+// The decoding GraphManager did before the SAX decoder.
+static void domGraph(const std::string &data, Graph *graph) {
+  std::string err;
+  json11::Json json = json11::Json::parse(data, err);
+  auto items = json.object_items();
+  graph->id = items["id"].int_value();
+  graph->name = items["name"].string_value();
+  for (auto &it: items["works"].object_items()) {
+    auto w = it.second.object_items();
+    Work work = Work{};
+    work.id = w["id"].int_value();
+    work.content = w["content"].string_value();
+    for (auto &p: w["related_people"].array_items()) {
+      work.related_people.push_back(p.string_value());
+    }
+    work.status = Status(w["status"].int_value());
+    work.priority = w["priority"].int_value();
+    parseTime(w["updated_at"].string_value().c_str(), &work.updatedAt);
+    for (auto &e: w["events"].array_items()) {
+      auto items = e.object_items();
+      Event event = Event{};
+      event.id = items["id"].int_value();
+      event.content = items["content"].string_value();
+      parseTime(items["created_at"].string_value().c_str(), &event.createdAt);
+      work.events.push_back(event);
+    }
+    graph->works[it.first] = work;
+  }
+}
+
+static void arenaGraph(const std::string &data, json11::JsonDocument *doc, Graph *graph) {
+  std::string err;
+  doc->parse(data, err);
+  auto root = doc->root();
+  graph->id = root["id"].int_value();
+  graph->name = root["name"].string_value().str();
+  auto works = root["works"];
+  for (size_t i = 0; i < works.size(); i++) {
+    auto w = works.value(i);
+    Work work = Work{};
+    work.id = w["id"].int_value();
+    work.content = w["content"].string_value().str();
+    auto people = w["related_people"];
+    for (size_t j = 0; j < people.size(); j++) {
+      work.related_people.push_back(people[j].string_value().str());
+    }
+    work.status = Status(w["status"].int_value());
+    work.priority = w["priority"].int_value();
+    parseTime(w["updated_at"].string_value().str().c_str(), &work.updatedAt);
+    auto events = w["events"];
+    for (size_t j = 0; j < events.size(); j++) {
+      auto e = events[j];
+      Event event = Event{};
+      event.id = e["id"].int_value();
+      event.content = e["content"].string_value().str();
+      parseTime(e["created_at"].string_value().str().c_str(), &event.createdAt);
+      work.events.push_back(event);
+    }
+    graph->works[works.key(i).str()] = work;
+  }
+}
+
+int main(int argc, char **argv) {
+  int works = argc > 1 ? std::atoi(argv[1]) : 1000;
+  int events = argc > 2 ? std::atoi(argv[2]) : 50;
+  int rounds = argc > 3 ? std::atoi(argv[3]) : 5;
+
+  std::string data = legacyGraph(works, events);
+  std::printf("document: %.1f MB, %d works, %d events\n", data.size() / 1048576.0, works, works * events);
+
+  // Parsing alone, without copying into structs.
+  size_t before = allocations;
+  auto start = Clock::now();
+  for (int i = 0; i < rounds; i++) {
+    std::string err;
+    json11::Json::parse(data, err);
+  }
+  report("parse dom", rounds, data.size(), allocations - before, secondsSince(start));
+
+  json11::JsonDocument doc;
+  before = allocations;
+  start = Clock::now();
+  for (int i = 0; i < rounds; i++) {
+    std::string err;
+    doc.parse(data, err);
+  }
+  report("parse arena", rounds, data.size(), allocations - before, secondsSince(start));
+
+  before = allocations;
+  start = Clock::now();
+  size_t checksum = 0;
+  for (int i = 0; i < rounds; i++) {
+    Graph graph;
+    domGraph(data, &graph);
+    checksum += graph.works.size();
+  }
+  report("dom", rounds, data.size(), allocations - before, secondsSince(start));
+
+  before = allocations;
+  start = Clock::now();
+  for (int i = 0; i < rounds; i++) {
+    Graph graph;
+    arenaGraph(data, &doc, &graph);
+    checksum -= graph.works.size();
+  }
+  report("arena", rounds, data.size(), allocations - before, secondsSince(start));
+
+  before = allocations;
+  start = Clock::now();
+  for (int i = 0; i < rounds; i++) {
+    Graph graph;
+    std::string err;
+    if (!ParseGraphJson(data, &graph, &err)) {
+      std::fprintf(stderr, "parse failed: %s\n", err.c_str());
+      return 1;
+    }
+    checksum += graph.works.size();
+  }
+  report("sax", rounds, data.size(), allocations - before, secondsSince(start));
+  return checksum == static_cast<size_t>(works) * rounds ? 0 : 1;
+}
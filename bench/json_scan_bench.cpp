@@ -0,0 +1,162 @@
+// Measures json11 on string-heavy documents, where parsing and dumping are
+// dominated by the vectorized scans over string content and whitespace. The
+// dump rows compare Json::dump with the byte-at-a-time serializer it replaced
+// and fail if their outputs differ.
+//
+//   json_scan_bench [events] [content_bytes] [rounds]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "bench.h"
+#include "json11.hpp"
+
+static void report(const char *name, int rounds, size_t bytes, double seconds) {
+  std::printf("%-16s %10.2f GB/s\n", name, bytes * rounds / seconds / (1024.0 * 1048576.0));
+}
+
+// The serializer json11 used before the scans.
+static void scalarDump(const std::string &value, std::string &out) {
+  out += '"';
+  for (size_t i = 0; i < value.length(); i++) {
+    const char ch = value[i];
+    if (ch == '\\') {
+      out += "\\\\";
+    } else if (ch == '"') {
+      out += "\\\"";
+    } else if (ch == '\b') {
+      out += "\\b";
+    } else if (ch == '\f') {
+      out += "\\f";
+    } else if (ch == '\n') {
+      out += "\\n";
+    } else if (ch == '\r') {
+      out += "\\r";
+    } else if (ch == '\t') {
+      out += "\\t";
+    } else if (static_cast<uint8_t>(ch) <= 0x1f) {
+      char buf[8];
+      snprintf(buf, sizeof buf, "\\u%04x", ch);
+      out += buf;
+    } else if (static_cast<uint8_t>(ch) == 0xe2 && static_cast<uint8_t>(value[i + 1]) == 0x80
+               && static_cast<uint8_t>(value[i + 2]) == 0xa8) {
+      out += "\\u2028";
+      i += 2;
+    } else if (static_cast<uint8_t>(ch) == 0xe2 && static_cast<uint8_t>(value[i + 1]) == 0x80
+               && static_cast<uint8_t>(value[i + 2]) == 0xa9) {
+      out += "\\u2029";
+      i += 2;
+    } else {
+      out += ch;
+    }
+  }
+  out += '"';
+}
+
+static std::string content(int i, int bytes) {
+  static const char *words[] = {"event ", "content ", "for ", "work ", "包含中文 ", "status ", "\"quoted\" ",
+                                "line\n", "tab\t", "dash \xe2\x80\x94 ", "sep \xe2\x80\xa8 "};
+  std::string s;
+  // Mostly plain text: one word in 64 needs escaping.
+  for (unsigned k = i; static_cast<int>(s.size()) < bytes; k = k * 1103515245 + 12345) {
+    unsigned w = (k >> 16) % 64;
+    s += words[w < 63 ? w % 6 : 6 + (k >> 24) % 5];
+  }
+  return s;
+}
+
+int main(int argc, char **argv) {
+  int events = argc > 1 ? std::atoi(argv[1]) : 2000;
+  int bytes = argc > 2 ? std::atoi(argv[2]) : 2048;
+  int rounds = argc > 3 ? std::atoi(argv[3]) : 20;
+
+  std::vector<std::string> strings;
+  json11::Json::array items;
+  for (int i = 0; i < events; i++) {
+    strings.push_back(content(i + 1, bytes));
+    items.push_back(json11::Json::object{{"id", i}, {"content", strings.back()}});
+  }
+  std::string doc = json11::Json(items).dump();
+  // The same document with two-space indentation, for the whitespace scan.
+  std::string pretty;
+  int depth = 0;
+  bool in_string = false;
+  for (size_t i = 0; i < doc.size(); i++) {
+    char c = doc[i];
+    pretty += c;
+    if (in_string) {
+      if (c == '\\') {
+        pretty += doc[++i];
+      } else if (c == '"') {
+        in_string = false;
+      }
+    } else if (c == '"') {
+      in_string = true;
+    } else if (c == '{' || c == '[' || c == ',') {
+      depth += c == ',' ? 0 : 1;
+      pretty += '\n' + std::string(2 * depth, ' ');
+    } else if (c == '}' || c == ']') {
+      depth--;
+    } else if (c == ':') {
+      pretty += ' ';
+    }
+  }
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  const char *isa = __builtin_cpu_supports("avx2") ? "avx2" : "sse2";
+#else
+  const char *isa = "scalar";
+#endif
+  std::printf("document: %.1f MB (%.1f MB indented), %d strings of %d bytes, scanner %s\n",
+              doc.size() / 1048576.0, pretty.size() / 1048576.0, events, bytes, isa);
+
+  std::string err;
+  auto start = Clock::now();
+  for (int i = 0; i < rounds; i++) {
+    if (json11::Json::parse(doc, err).array_items().size() != items.size()) {
+      std::fprintf(stderr, "parse failed: %s\n", err.c_str());
+      return 1;
+    }
+  }
+  report("parse dom", rounds, doc.size(), secondsSince(start));
+
+  json11::JsonDocument document;
+  for (const std::string *in: {&doc, &pretty}) {
+    start = Clock::now();
+    for (int i = 0; i < rounds; i++) {
+      if (!document.parse(*in, err) || document.root()[events - 1]["content"].string_value().str() != strings.back()) {
+        std::fprintf(stderr, "parse failed: %s\n", err.c_str());
+        return 1;
+      }
+    }
+    report(in == &doc ? "parse arena" : "parse indented", rounds, in->size(), secondsSince(start));
+  }
+
+  size_t total = 0;
+  for (auto &s: strings) {
+    total += s.size();
+  }
+  std::string out;
+  start = Clock::now();
+  for (int i = 0; i < rounds; i++) {
+    out.clear();
+    for (auto &s: strings) {
+      scalarDump(s, out);
+    }
+  }
+  report("dump scalar", rounds, total, secondsSince(start));
+  std::string expected = out;
+
+  start = Clock::now();
+  for (int i = 0; i < rounds; i++) {
+    out.clear();
+    for (auto &s: strings) {
+      json11::Json::dump_string(s, out);
+    }
+  }
+  report("dump", rounds, total, secondsSince(start));
+  if (out != expected) {
+    std::fprintf(stderr, "dump output differs from the scalar serializer\n");
+    return 1;
+  }
+  return 0;
+}
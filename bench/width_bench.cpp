@@ -0,0 +1,89 @@
+// Compares getStrWidth with the mbstowcs and wcwidth version it replaced, and
+// StrWidthCache on a column that repeats a few values, on ASCII, Chinese and
+// mixed cells like those of the list tables.
+//
+//   width_bench [rows]
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "util.h"
+
+static void report(const char *name, size_t cells, size_t bytes, double seconds) {
+  std::printf("%-22s %12.0f cells/s %10.1f MB/s\n", name, cells / seconds, bytes / seconds / 1048576.0);
+}
+
+static int wcwidthWidth(const char *s) {
+  size_t n = std::mbstowcs(NULL, s, 0);
+  if (n == static_cast<size_t>(-1)) {
+    return -1;
+  }
+  std::unique_ptr<wchar_t[]> ws(new wchar_t[n + 1]);
+  std::mbstowcs(ws.get(), s, n + 1);
+  int width = 0;
+  for (size_t i = 0; i < n; i++) {
+    int w = wcwidth(ws[i]);
+    if (w > 0) {
+      width += w;
+    }
+  }
+  return width;
+}
+
+static bool run(const char *name, const std::vector<std::string> &cells) {
+  size_t bytes = 0;
+  for (auto &it: cells) {
+    bytes += it.size();
+  }
+  std::printf("%s\n", name);
+
+  auto start = Clock::now();
+  long want = 0;
+  for (auto &it: cells) {
+    want += wcwidthWidth(it.c_str());
+  }
+  report("  wcwidth", cells.size(), bytes, secondsSince(start));
+
+  start = Clock::now();
+  long got = 0;
+  for (auto &it: cells) {
+    got += getStrWidth(it.data(), it.size());
+  }
+  report("  getStrWidth", cells.size(), bytes, secondsSince(start));
+
+  // A column with one value per 20 rows, like the work of each event.
+  StrWidthCache cache;
+  start = Clock::now();
+  long cached = 0;
+  for (size_t i = 0; i < cells.size(); i++) {
+    cached += cache.Width(cells[i / 20 * 20]);
+  }
+  report("  StrWidthCache", cells.size(), bytes, secondsSince(start));
+  long repeated = 0;
+  for (size_t i = 0; i < cells.size(); i++) {
+    repeated += getStrWidth(cells[i / 20 * 20].c_str());
+  }
+  return want == got && cached == repeated;
+}
+
+int main(int argc, char **argv) {
+  int rows = argc > 1 ? std::atoi(argv[1]) : 100000;
+  std::setlocale(LC_ALL, "C.UTF-8");
+
+  std::vector<std::string> ascii, chinese, mixed;
+  for (int i = 0; i < rows; i++) {
+    ascii.push_back("event content " + std::to_string(i) + " for the work that is being listed");
+    chinese.push_back("事件内容" + std::to_string(i) + "属于正在列出的工作");
+    mixed.push_back("event " + std::to_string(i) + " 包含中文 and some more text");
+  }
+  bool ok = run("ascii", ascii);
+  ok = run("chinese", chinese) && ok;
+  ok = run("mixed", mixed) && ok;
+  // Both must agree on every cell.
+  return ok ? 0 : 1;
+}
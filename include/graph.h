@@ -4,7 +4,7 @@
 #include <string>
 #include <map>
 #include <vector>
-#include <time.h>
+#include <stdint.h>
 
 
 enum Status {
@@ -16,7 +16,7 @@ enum Status {
 struct Event {
     int id;
     std::string content;
-    struct tm createdAt;
+    int64_t createdAt;  // microseconds since the epoch
 };
 
 struct Work {
@@ -26,7 +26,7 @@ struct Work {
     Status status;
     int priority;
     std::vector<Event> events;
-    struct tm updatedAt;
+    int64_t updatedAt;  // microseconds since the epoch
 };
 
 struct Relation {
@@ -36,6 +36,11 @@ struct Relation {
     std::string description;
 };
 
+struct Checkpoint {
+    int id;
+    int64_t createdAt;  // microseconds since the epoch
+};
+
 struct Graph {
     int id;
     std::map<std::string, Work> works;
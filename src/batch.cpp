@@ -0,0 +1,135 @@
+#include <cmath>
+#include <iostream>
+
+#include "batch.h"
+#include "json11.hpp"
+
+// Appends a flag token (without its leading dashes) as name=value; a bare
+// name is a boolean flag set to true.
+static void appendFlag(const std::string &flag, std::vector<std::string> *args) {
+  if (flag.find('=') == std::string::npos) {
+    args->push_back(flag + "=true");
+  } else {
+    args->push_back(flag);
+  }
+}
+
+bool ParseCommandLine(const std::string &line, std::vector<std::string> *args, std::string *err) {
+  std::vector<std::string> tokens;
+  std::string token;
+  bool inToken = false;
+  char quote = 0;
+  for (size_t i = 0; i < line.size(); i++) {
+    char c = line[i];
+    if (quote == '\'') {
+      if (c == '\'') {
+        quote = 0;
+      } else {
+        token.push_back(c);
+      }
+    } else if (c == '\\' && i + 1 < line.size() && (quote == 0 || line[i + 1] == '"' || line[i + 1] == '\\')) {
+      token.push_back(line[++i]);
+      inToken = true;
+    } else if (quote == '"') {
+      if (c == '"') {
+        quote = 0;
+      } else {
+        token.push_back(c);
+      }
+    } else if (c == '\'' || c == '"') {
+      quote = c;
+      inToken = true;
+    } else if (c == ' ' || c == '\t' || c == '\r') {
+      if (inToken) {
+        tokens.push_back(token);
+        token.clear();
+        inToken = false;
+      }
+    } else {
+      token.push_back(c);
+      inToken = true;
+    }
+  }
+  if (quote != 0) {
+    *err = "unterminated quote";
+    return false;
+  }
+  if (inToken) {
+    tokens.push_back(token);
+  }
+
+  std::vector<std::string> flags;
+  for (auto &it: tokens) {
+    if (it.size() > 1 && it[0] == '-') {
+      flags.push_back(it.substr(it[1] == '-' ? 2 : 1));
+    } else {
+      args->push_back(it);
+    }
+  }
+  if (args->size() != 2) {
+    *err = "expected an action and a resource";
+    return false;
+  }
+  for (auto &it: flags) {
+    appendFlag(it, args);
+  }
+  return true;
+}
+
+bool ParseCommandJson(const std::string &line, std::vector<std::string> *args, std::string *err) {
+  json11::Json json = json11::Json::parse(line, *err);
+  if (!err->empty()) {
+    return false;
+  }
+  if (!json["action"].is_string() || !json["resource"].is_string()) {
+    *err = "action and resource must be strings";
+    return false;
+  }
+  args->push_back(json["action"].string_value());
+  args->push_back(json["resource"].string_value());
+  for (auto &it: json.object_items()) {
+    if (it.first == "action" || it.first == "resource") {
+      continue;
+    }
+    const json11::Json &v = it.second;
+    if (v.is_string()) {
+      args->push_back(it.first + "=" + v.string_value());
+    } else if (v.is_bool()) {
+      args->push_back(it.first + (v.bool_value() ? "=true" : "=false"));
+    } else if (v.is_number() && v.number_value() == std::floor(v.number_value())) {
+      args->push_back(it.first + "=" + std::to_string(static_cast<long long>(v.number_value())));
+    } else if (v.is_number()) {
+      args->push_back(it.first + "=" + v.dump());
+    } else {
+      *err = "unsupported value for " + it.first;
+      return false;
+    }
+  }
+  return true;
+}
+
+int RunScript(std::istream &in, const std::function<int(const std::vector<std::string> &args)> &handler) {
+  int failed = 0;
+  int lineNo = 0;
+  std::string line;
+  while (std::getline(in, line)) {
+    lineNo++;
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#') {
+      continue;
+    }
+    std::vector<std::string> args;
+    std::string err;
+    bool ok = line[start] == '{' ? ParseCommandJson(line, &args, &err) : ParseCommandLine(line, &args, &err);
+    if (!ok) {
+      std::cerr << "line " << lineNo << ": " << err << std::endl;
+      failed++;
+      continue;
+    }
+    if (handler(args) != 0) {
+      std::cerr << "line " << lineNo << ": command failed" << std::endl;
+      failed++;
+    }
+  }
+  return failed;
+}
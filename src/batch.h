@@ -0,0 +1,25 @@
+#ifndef GRAPH_BATCH_H_
+#define GRAPH_BATCH_H_
+
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+// Scripts hold one command per line, either in command line form
+//   ad e --gi=1 --wi=2 --ec="found the cause"
+// or as an NDJSON object
+//   {"action": "ad", "resource": "e", "gi": 1, "wi": 2, "ec": "found the cause"}
+// Both are turned into the argument list used by the daemon: action,
+// resource, then name=value for every flag. Empty lines and lines starting
+// with # are skipped.
+
+bool ParseCommandLine(const std::string &line, std::vector<std::string> *args, std::string *err);
+
+bool ParseCommandJson(const std::string &line, std::vector<std::string> *args, std::string *err);
+
+// Runs every command of in through handler and returns the number of
+// commands that could not be parsed or returned non-zero.
+int RunScript(std::istream &in, const std::function<int(const std::vector<std::string> &args)> &handler);
+
+#endif
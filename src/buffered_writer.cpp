@@ -0,0 +1,22 @@
+#include <errno.h>
+#include <unistd.h>
+
+#include "buffered_writer.h"
+
+bool BufferedWriter::Flush() {
+  size_t off = 0;
+  while (!failed_ && off < buffer_.size()) {
+    ssize_t n = write(fd_, buffer_.data() + off, buffer_.size() - off);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      failed_ = true;
+      break;
+    }
+    off += n;
+  }
+  written_ += off;
+  buffer_.clear();
+  return !failed_;
+}
@@ -0,0 +1,38 @@
+#ifndef GRAPH_BUFFERED_WRITER_H_
+#define GRAPH_BUFFERED_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Collects output in a fixed-size buffer and hands it to write(2) once full.
+class BufferedWriter {
+public:
+    static const size_t kBufferBytes = 1 << 20;
+
+    explicit BufferedWriter(int fd) : fd_(fd), written_(0), failed_(false) { buffer_.reserve(kBufferBytes + 4096); }
+
+    // Lines are appended to the buffer directly and committed with EndLine.
+    std::string *buffer() { return &buffer_; }
+
+    void EndLine() {
+      buffer_.push_back('\n');
+      if (buffer_.size() >= kBufferBytes) {
+        Flush();
+      }
+    }
+
+    bool Flush();
+
+    bool failed() const { return failed_; }
+
+    uint64_t written() const { return written_; }
+
+private:
+    int fd_;
+    std::string buffer_;
+    uint64_t written_;
+    bool failed_;
+};
+
+#endif
@@ -0,0 +1,336 @@
+#include "codec.h"
+#include "fields.h"
+
+// Field numbers come from fields.h. Never reuse a number once a field is
+// removed.
+static_assert(kWorkFieldId == 1u << WorkFieldNumber::id && kWorkFieldContent == 1u << WorkFieldNumber::content &&
+              kWorkFieldRelatedPeople == 1u << WorkFieldNumber::related_people &&
+              kWorkFieldStatus == 1u << WorkFieldNumber::status &&
+              kWorkFieldPriority == 1u << WorkFieldNumber::priority &&
+              kWorkFieldUpdatedAt == 1u << WorkFieldNumber::updatedAt,
+              "work field masks must match the field numbers");
+static_assert(kEventFieldId == 1u << EventFieldNumber::id && kEventFieldContent == 1u << EventFieldNumber::content &&
+              kEventFieldCreatedAt == 1u << EventFieldNumber::createdAt,
+              "event field masks must match the field numbers");
+
+void PutVarint64(std::string *dst, uint64_t v) {
+  char buf[10];
+  int n = 0;
+  while (v >= 0x80) {
+    buf[n++] = static_cast<char>(v | 0x80);
+    v >>= 7;
+  }
+  buf[n++] = static_cast<char>(v);
+  dst->append(buf, n);
+}
+
+bool GetVarint64(leveldb::Slice *input, uint64_t *v) {
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(input->data());
+  const unsigned char *limit = p + input->size();
+  uint64_t result = 0;
+  for (int shift = 0; shift <= 63 && p < limit; shift += 7) {
+    uint64_t byte = *p++;
+    result |= (byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      *v = result;
+      input->remove_prefix(p - reinterpret_cast<const unsigned char *>(input->data()));
+      return true;
+    }
+  }
+  return false;
+}
+
+void PutLengthPrefixed(std::string *dst, const leveldb::Slice &value) {
+  PutVarint64(dst, value.size());
+  dst->append(value.data(), value.size());
+}
+
+bool GetLengthPrefixed(leveldb::Slice *input, leveldb::Slice *value) {
+  uint64_t len;
+  if (!GetVarint64(input, &len) || len > input->size()) {
+    return false;
+  }
+  *value = leveldb::Slice(input->data(), len);
+  input->remove_prefix(len);
+  return true;
+}
+
+bool IsBinaryRecord(const leveldb::Slice &value) {
+  return !value.empty() && value[0] == kRecordVersion;
+}
+
+static uint64_t zigzag(int64_t v) {
+  return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+  return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+static void putTag(std::string *dst, int field, WireType type) {
+  PutVarint64(dst, (static_cast<uint64_t>(field) << 3) | type);
+}
+
+static void putInt(std::string *dst, int field, int64_t v) {
+  putTag(dst, field, kWireVarint);
+  PutVarint64(dst, zigzag(v));
+}
+
+static void putString(std::string *dst, int field, const std::string &v) {
+  putTag(dst, field, kWireBytes);
+  PutLengthPrefixed(dst, v);
+}
+
+namespace {
+
+// Field is one decoded (tag, payload) pair of a record.
+struct Field {
+    int number;
+    WireType type;
+    int64_t i;
+    leveldb::Slice bytes;
+};
+
+// Reads the version byte and iterates over the fields of a record.
+class FieldReader {
+public:
+    FieldReader(leveldb::Slice input)
+            : input_(input), ok_(IsBinaryRecord(input)), mask_(~0u), pending_(~0u), done_(false) {
+      if (ok_) {
+        input_.remove_prefix(1);
+      }
+    }
+
+    bool Next(Field *field) {
+      if (!ok_ || input_.empty()) {
+        return false;
+      }
+      uint64_t tag;
+      if (!GetVarint64(&input_, &tag)) {
+        ok_ = false;
+        return false;
+      }
+      field->number = static_cast<int>(tag >> 3);
+      field->type = static_cast<WireType>(tag & 7);
+      uint64_t v;
+      switch (field->type) {
+        case kWireVarint:
+          ok_ = GetVarint64(&input_, &v);
+          field->i = unzigzag(v);
+          break;
+        case kWireBytes:
+          field->i = 0;
+          ok_ = GetLengthPrefixed(&input_, &field->bytes);
+          break;
+        default:
+          ok_ = false;
+      }
+      return ok_;
+    }
+
+    bool ok() const { return ok_; }
+
+    // Restricts NextWanted to the fields in mask. It skips the others and
+    // reports the end of the record once every field in mask has been
+    // returned, unless mask includes one of the repeated fields.
+    void Project(uint32_t mask, uint32_t repeated) {
+      mask_ = mask;
+      pending_ = mask & ~repeated;
+      done_ = (mask & repeated) == 0;
+    }
+
+    bool NextWanted(Field *field) {
+      while ((pending_ != 0 || !done_) && Next(field)) {
+        uint32_t bit = field->number < 32 ? 1u << field->number : 0;
+        if ((mask_ & bit) != 0) {
+          pending_ &= ~bit;
+          return true;
+        }
+      }
+      return false;
+    }
+
+private:
+    leveldb::Slice input_;
+    bool ok_;
+    uint32_t mask_;
+    uint32_t pending_;
+    bool done_;
+};
+
+}  // namespace
+
+namespace {
+
+// Writes each field of a record as its tag and payload. Repeated fields are
+// written once per element.
+struct FieldWriter {
+    std::string *dst;
+
+    void operator()(int number, const char *, int v) const { putInt(dst, number, v); }
+
+    void operator()(int number, const char *, Status v) const { putInt(dst, number, v); }
+
+    void operator()(int number, const char *, const std::string &v) const { putString(dst, number, v); }
+
+    void operator()(int number, const char *, const std::vector<std::string> &v) const {
+      for (auto &it: v) {
+        putString(dst, number, it);
+      }
+    }
+
+    void operator()(int number, const char *, int64_t v) const { putInt(dst, number, v); }
+};
+
+// Stores the payload of a decoded field into the member it belongs to.
+struct FieldSetter {
+    const Field &f;
+
+    void operator()(int, const char *, int &v) const { v = static_cast<int>(f.i); }
+
+    void operator()(int, const char *, Status &v) const { v = static_cast<Status>(f.i); }
+
+    void operator()(int, const char *, int64_t &v) const { v = f.i; }
+
+    void operator()(int, const char *, leveldb::Slice &v) const { v = f.bytes; }
+
+    void operator()(int, const char *, std::string &v) const { v.assign(f.bytes.data(), f.bytes.size()); }
+
+    void operator()(int, const char *, std::vector<leveldb::Slice> &v) const { v.push_back(f.bytes); }
+};
+
+// Resets every field of a view.
+struct FieldClearer {
+    void operator()(int, const char *, int &v) const { v = 0; }
+
+    void operator()(int, const char *, Status &v) const { v = kStart; }
+
+    void operator()(int, const char *, int64_t &v) const { v = 0; }
+
+    void operator()(int, const char *, leveldb::Slice &v) const { v.clear(); }
+
+    void operator()(int, const char *, std::vector<leveldb::Slice> &v) const { v.clear(); }
+};
+
+}  // namespace
+
+void EncodeGraph(const Graph &graph, std::string *dst) {
+  dst->push_back(kRecordVersion);
+  ForEachGraphField(graph, FieldWriter{dst});
+}
+
+bool DecodeGraphView(leveldb::Slice input, GraphView *graph) {
+  ForEachGraphField(*graph, FieldClearer());
+  FieldReader reader(input);
+  Field f;
+  while (reader.Next(&f)) {
+    VisitGraphField(*graph, f.number, FieldSetter{f});
+  }
+  return reader.ok();
+}
+
+bool DecodeGraph(leveldb::Slice input, Graph *graph) {
+  GraphView view;
+  if (!DecodeGraphView(input, &view)) {
+    return false;
+  }
+  graph->id = view.id;
+  graph->name.assign(view.name.data(), view.name.size());
+  return true;
+}
+
+void EncodeWork(const Work &work, std::string *dst) {
+  dst->push_back(kRecordVersion);
+  ForEachWorkField(work, FieldWriter{dst});
+}
+
+bool DecodeWorkView(leveldb::Slice input, WorkView *work, uint32_t fields) {
+  ForEachWorkField(*work, FieldClearer());
+  FieldReader reader(input);
+  reader.Project(fields, kWorkFieldRelatedPeople);
+  Field f;
+  while (reader.NextWanted(&f)) {
+    VisitWorkField(*work, f.number, FieldSetter{f});
+  }
+  return reader.ok();
+}
+
+void MaterializeWork(const WorkView &view, Work *work) {
+  work->id = view.id;
+  work->content.assign(view.content.data(), view.content.size());
+  work->related_people.clear();
+  for (auto &it: view.related_people) {
+    work->related_people.push_back(it.ToString());
+  }
+  work->status = view.status;
+  work->priority = view.priority;
+  work->updatedAt = view.updatedAt;
+}
+
+bool DecodeWork(leveldb::Slice input, Work *work) {
+  WorkView view;
+  if (!DecodeWorkView(input, &view)) {
+    return false;
+  }
+  MaterializeWork(view, work);
+  return true;
+}
+
+void EncodeEvent(const Event &event, std::string *dst) {
+  dst->push_back(kRecordVersion);
+  ForEachEventField(event, FieldWriter{dst});
+}
+
+bool DecodeEventView(leveldb::Slice input, EventView *event, uint32_t fields) {
+  ForEachEventField(*event, FieldClearer());
+  FieldReader reader(input);
+  reader.Project(fields, 0);
+  Field f;
+  while (reader.NextWanted(&f)) {
+    VisitEventField(*event, f.number, FieldSetter{f});
+  }
+  return reader.ok();
+}
+
+void MaterializeEvent(const EventView &view, Event *event) {
+  event->id = view.id;
+  event->content.assign(view.content.data(), view.content.size());
+  event->createdAt = view.createdAt;
+}
+
+bool DecodeEvent(leveldb::Slice input, Event *event) {
+  EventView view;
+  if (!DecodeEventView(input, &view)) {
+    return false;
+  }
+  MaterializeEvent(view, event);
+  return true;
+}
+
+void EncodeRelation(const Relation &relation, std::string *dst) {
+  dst->push_back(kRecordVersion);
+  ForEachRelationField(relation, FieldWriter{dst});
+}
+
+bool DecodeRelation(leveldb::Slice input, Relation *relation) {
+  FieldReader reader(input);
+  Field f;
+  while (reader.Next(&f)) {
+    VisitRelationField(*relation, f.number, FieldSetter{f});
+  }
+  return reader.ok();
+}
+
+void EncodeCheckpoint(const Checkpoint &checkpoint, std::string *dst) {
+  dst->push_back(kRecordVersion);
+  ForEachCheckpointField(checkpoint, FieldWriter{dst});
+}
+
+bool DecodeCheckpoint(leveldb::Slice input, Checkpoint *checkpoint) {
+  FieldReader reader(input);
+  Field f;
+  while (reader.Next(&f)) {
+    VisitCheckpointField(*checkpoint, f.number, FieldSetter{f});
+  }
+  return reader.ok();
+}
@@ -0,0 +1,111 @@
+#ifndef GRAPH_CODEC_H_
+#define GRAPH_CODEC_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "leveldb/slice.h"
+#include "graph.h"
+
+// Binary record format used for every value stored in leveldb.
+//
+// A record starts with a one byte format version followed by fields. Each
+// field is a varint tag (field_number << 3 | wire_type) and a payload:
+//   kWireVarint  varint, signed values are zigzag encoded
+//   kWireBytes   varint length followed by raw bytes
+// Decoders skip fields they do not know, so new fields can be added without
+// rewriting existing records. Timestamps are microseconds since the epoch.
+const char kRecordVersion = 1;
+
+enum WireType {
+    kWireVarint = 0,
+    kWireBytes = 2,
+};
+
+void PutVarint64(std::string *dst, uint64_t v);
+
+bool GetVarint64(leveldb::Slice *input, uint64_t *v);
+
+void PutLengthPrefixed(std::string *dst, const leveldb::Slice &value);
+
+bool GetLengthPrefixed(leveldb::Slice *input, leveldb::Slice *value);
+
+// Returns true if value is a record written by this codec rather than JSON.
+bool IsBinaryRecord(const leveldb::Slice &value);
+
+// Views decode a record without copying it: string fields point into the
+// decoded input and are valid only as long as it is, e.g. while an iterator
+// stays on the entry. Times stay epoch microseconds. Every field is reset
+// before decoding, so one view can be reused for many records.
+struct GraphView {
+    int id;
+    leveldb::Slice name;
+};
+
+struct WorkView {
+    int id;
+    leveldb::Slice content;
+    std::vector<leveldb::Slice> related_people;
+    Status status;
+    int priority;
+    int64_t updatedAt;
+};
+
+struct EventView {
+    int id;
+    leveldb::Slice content;
+    int64_t createdAt;
+};
+
+// Field masks for the view decoders, one bit per field number. Fields not
+// in the mask are stepped over without being stored and keep their reset
+// value, and decoding stops as soon as every requested field has been seen.
+const uint32_t kWorkFieldId = 1 << 1;
+const uint32_t kWorkFieldContent = 1 << 2;
+const uint32_t kWorkFieldRelatedPeople = 1 << 3;
+const uint32_t kWorkFieldStatus = 1 << 4;
+const uint32_t kWorkFieldPriority = 1 << 5;
+const uint32_t kWorkFieldUpdatedAt = 1 << 6;
+const uint32_t kWorkFieldsAll = ~0u;
+
+const uint32_t kEventFieldId = 1 << 1;
+const uint32_t kEventFieldContent = 1 << 2;
+const uint32_t kEventFieldCreatedAt = 1 << 3;
+const uint32_t kEventFieldsAll = ~0u;
+
+bool DecodeGraphView(leveldb::Slice input, GraphView *graph);
+
+bool DecodeWorkView(leveldb::Slice input, WorkView *work, uint32_t fields = kWorkFieldsAll);
+
+bool DecodeEventView(leveldb::Slice input, EventView *event, uint32_t fields = kEventFieldsAll);
+
+// Copies a view into the owning struct.
+void MaterializeWork(const WorkView &view, Work *work);
+
+void MaterializeEvent(const EventView &view, Event *event);
+
+// Graph records only hold the header; works and relations are stored under
+// their own keys.
+void EncodeGraph(const Graph &graph, std::string *dst);
+
+bool DecodeGraph(leveldb::Slice input, Graph *graph);
+
+// Work records do not include events.
+void EncodeWork(const Work &work, std::string *dst);
+
+bool DecodeWork(leveldb::Slice input, Work *work);
+
+void EncodeEvent(const Event &event, std::string *dst);
+
+bool DecodeEvent(leveldb::Slice input, Event *event);
+
+void EncodeRelation(const Relation &relation, std::string *dst);
+
+bool DecodeRelation(leveldb::Slice input, Relation *relation);
+
+void EncodeCheckpoint(const Checkpoint &checkpoint, std::string *dst);
+
+bool DecodeCheckpoint(leveldb::Slice input, Checkpoint *checkpoint);
+
+#endif
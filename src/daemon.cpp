@@ -0,0 +1,248 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstdio>
+#include <iostream>
+
+#include "daemon.h"
+
+// stdout and stderr, installed as 1 and 2.
+static const int kPassedFds = 2;
+static const uint32_t kMaxRequest = 64 << 20;
+static const uint32_t kMaxInput = 1u << 30;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onStop(int) {
+  stopping = 1;
+}
+
+static bool socketAddress(const std::string &path, struct sockaddr_un *addr) {
+  if (path.size() >= sizeof(addr->sun_path)) {
+    std::cerr << "socket path too long: " << path << std::endl;
+    return false;
+  }
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  memcpy(addr->sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+static bool writeAll(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, data, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool readAll(int fd, char *data, size_t size) {
+  while (size > 0) {
+    ssize_t n = read(fd, data, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+// Reads one request; fds receives the descriptors passed along with it.
+static bool readRequest(int conn, int *fds, std::vector<std::string> *args, std::string *input) {
+  uint32_t lengths[2];
+  char control[CMSG_SPACE(sizeof(int) * kPassedFds)];
+  struct iovec iov = {lengths, sizeof(lengths)};
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t n;
+  do {
+    n = recvmsg(conn, &msg, 0);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) {
+    return false;
+  }
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(sizeof(int) * kPassedFds)) {
+    return false;
+  }
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * kPassedFds);
+  if (n < static_cast<ssize_t>(sizeof(lengths)) &&
+      !readAll(conn, reinterpret_cast<char *>(lengths) + n, sizeof(lengths) - n)) {
+    return false;
+  }
+  if (lengths[0] > kMaxRequest || lengths[1] > kMaxInput) {
+    return false;
+  }
+  std::string body(lengths[0], '\0');
+  input->resize(lengths[1]);
+  if (!readAll(conn, &body[0], body.size()) || !readAll(conn, &(*input)[0], input->size())) {
+    return false;
+  }
+  for (size_t start = 0; start < body.size();) {
+    size_t end = body.find('\0', start);
+    if (end == std::string::npos) {
+      return false;
+    }
+    args->push_back(body.substr(start, end - start));
+    start = end + 1;
+  }
+  return true;
+}
+
+// Runs handler with the client's descriptors installed as 1 and 2.
+static int serve(const int *fds, const std::vector<std::string> &args, const std::string &input,
+                 const DaemonHandler &handler) {
+  int saved[kPassedFds];
+  for (int i = 0; i < kPassedFds; i++) {
+    saved[i] = dup(i + 1);
+    dup2(fds[i], i + 1);
+  }
+  int code = handler(args, input);
+  std::cout.flush();
+  std::cerr.flush();
+  std::fflush(stdout);
+  std::fflush(stderr);
+  for (int i = 0; i < kPassedFds; i++) {
+    dup2(saved[i], i + 1);
+    close(saved[i]);
+  }
+  return code;
+}
+
+int ServeDaemon(const std::string &path, const DaemonHandler &handler) {
+  struct sockaddr_un addr;
+  if (!socketAddress(path, &addr)) {
+    return 1;
+  }
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    std::cerr << "create socket failed: " << strerror(errno) << std::endl;
+    return 1;
+  }
+  // The caller holds the DB lock, so no other daemon can be using path.
+  unlink(path.c_str());
+  if (bind(listener, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(listener, 16) != 0) {
+    std::cerr << "listen on " << path << " failed: " << strerror(errno) << std::endl;
+    close(listener);
+    return 1;
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onStop;
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+  // A client that goes away mid-command must not take the daemon with it.
+  signal(SIGPIPE, SIG_IGN);
+
+  while (!stopping) {
+    int conn = accept(listener, nullptr, nullptr);
+    if (conn < 0) {
+      if (errno != EINTR) {
+        std::cerr << "accept failed: " << strerror(errno) << std::endl;
+      }
+      continue;
+    }
+    int fds[kPassedFds] = {-1, -1};
+    std::vector<std::string> args;
+    std::string input;
+    if (readRequest(conn, fds, &args, &input)) {
+      int32_t code = serve(fds, args, input, handler);
+      writeAll(conn, reinterpret_cast<const char *>(&code), sizeof(code));
+    }
+    for (int fd: fds) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+    close(conn);
+  }
+  close(listener);
+  unlink(path.c_str());
+  return 0;
+}
+
+bool RunRemote(const std::string &path, const std::vector<std::string> &args, const std::string &input, int *code) {
+  struct sockaddr_un addr;
+  if (path.size() >= sizeof(addr.sun_path) || access(path.c_str(), F_OK) != 0 || !socketAddress(path, &addr)) {
+    return false;
+  }
+  if (input.size() > kMaxInput) {
+    std::cerr << "input too large for the daemon" << std::endl;
+    *code = 1;
+    return true;
+  }
+  int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (conn < 0) {
+    return false;
+  }
+  if (connect(conn, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+    close(conn);
+    return false;
+  }
+
+  std::string body;
+  for (auto &it: args) {
+    body.append(it);
+    body.push_back('\0');
+  }
+  uint32_t lengths[2] = {static_cast<uint32_t>(body.size()), static_cast<uint32_t>(input.size())};
+  int fds[kPassedFds] = {STDOUT_FILENO, STDERR_FILENO};
+  char control[CMSG_SPACE(sizeof(fds))];
+  memset(control, 0, sizeof(control));
+  struct iovec iov = {lengths, sizeof(lengths)};
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  // Once the request is out the daemon owns the command; failures past this
+  // point are reported instead of silently running it a second time.
+  ssize_t n;
+  do {
+    n = sendmsg(conn, &msg, 0);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) {
+    close(conn);
+    return false;
+  }
+  int32_t result = 1;
+  if ((n < static_cast<ssize_t>(sizeof(lengths)) &&
+       !writeAll(conn, reinterpret_cast<const char *>(lengths) + n, sizeof(lengths) - n)) ||
+      !writeAll(conn, body.data(), body.size()) || !writeAll(conn, input.data(), input.size()) ||
+      !readAll(conn, reinterpret_cast<char *>(&result), sizeof(result))) {
+    std::cerr << "daemon connection lost" << std::endl;
+    result = 1;
+  }
+  close(conn);
+  *code = result;
+  return true;
+}
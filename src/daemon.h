@@ -0,0 +1,30 @@
+#ifndef GRAPH_DAEMON_H_
+#define GRAPH_DAEMON_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Local daemon protocol. A client connects to the Unix socket, hands over
+// its stdout and stderr with SCM_RIGHTS together with one request
+//   uint32 args length | uint32 input length | arg\0 arg\0 ... | input
+// and waits for the int32 exit code of the command. The daemon serves one
+// request at a time with the client's descriptors installed as its own 1/2,
+// so commands print exactly as they would in direct mode.
+//
+// The daemon never reads a client's stdin, where it could wait for input
+// while other clients queue behind it. A command that reads stdin has the
+// client read it to the end and send it as input instead.
+
+typedef std::function<int(const std::vector<std::string> &args, const std::string &input)> DaemonHandler;
+
+// Listens on path until SIGINT or SIGTERM, calling handler for every
+// request. A stale socket file left by a dead daemon is replaced.
+int ServeDaemon(const std::string &path, const DaemonHandler &handler);
+
+// Sends args and input to the daemon listening on path. Returns false
+// without side effects when no daemon is reachable, so the caller can run the
+// command itself.
+bool RunRemote(const std::string &path, const std::vector<std::string> &args, const std::string &input, int *code);
+
+#endif
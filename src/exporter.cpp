@@ -0,0 +1,129 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#include "buffered_writer.h"
+#include "exporter.h"
+#include "json_records.h"
+
+namespace {
+
+void appendInt(std::string *out, const char *name, int64_t v) {
+  char buf[48];
+  int n = std::snprintf(buf, sizeof(buf), ",\"%s\":%lld", name, static_cast<long long>(v));
+  out->append(buf, n);
+}
+
+class NdjsonVisitor : public GraphVisitor {
+public:
+    NdjsonVisitor(BufferedWriter *out) : out_(out), records_(0) {}
+
+    int VisitGraph(const Graph &graph) override {
+      std::string *line = begin("graph");
+      AppendGraphFields(graph, line);
+      return end();
+    }
+
+    int VisitWork(int gi, const Work &work) override {
+      std::string *line = begin("work");
+      appendInt(line, "gi", gi);
+      AppendWorkFields(work, line);
+      return end();
+    }
+
+    int VisitEvent(int gi, int wi, const Event &event) override {
+      std::string *line = begin("event");
+      appendInt(line, "gi", gi);
+      appendInt(line, "wi", wi);
+      AppendEventFields(event, line);
+      return end();
+    }
+
+    int VisitRelation(int gi, const Relation &relation) override {
+      std::string *line = begin("relation");
+      appendInt(line, "gi", gi);
+      AppendRelationFields(relation, line);
+      return end();
+    }
+
+    uint64_t records() const { return records_; }
+
+private:
+    BufferedWriter *out_;
+    uint64_t records_;
+
+    std::string *begin(const char *type) {
+      std::string *line = out_->buffer();
+      line->append("{\"type\":\"");
+      line->append(type);
+      line->push_back('"');
+      return line;
+    }
+
+    int end() {
+      out_->buffer()->push_back('}');
+      out_->EndLine();
+      records_++;
+      return out_->failed() ? 1 : 0;
+    }
+};
+
+}  // namespace
+
+int ExportGraphs(GraphManager *gm, int gi, const std::string &path) {
+  std::vector<int> ids;
+  if (gi != 0) {
+    ids.push_back(gi);
+  } else {
+    gm->ScanGraphs([&ids](const GraphView &graph) {
+      ids.push_back(graph.id);
+      return 0;
+    });
+  }
+
+  // Files are written next to their final name and renamed once complete,
+  // so an interrupted export never leaves a truncated backup behind.
+  bool toStdout = path == "-";
+  std::string tmp = path + ".tmp";
+  int fd = toStdout ? STDOUT_FILENO : open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    std::cerr << "open " << tmp << " failed" << std::endl;
+    return 1;
+  }
+  auto started = std::chrono::steady_clock::now();
+  BufferedWriter out(fd);
+  NdjsonVisitor visitor(&out);
+  int ret = 0;
+  for (int id: ids) {
+    ret = gm->ScanGraph(id, &visitor);
+    if (ret != 0) {
+      std::cerr << (out.failed() ? "write failed" : "export graph " + std::to_string(id) + " failed") << std::endl;
+      break;
+    }
+  }
+  if (ret == 0 && !out.Flush()) {
+    std::cerr << "write failed" << std::endl;
+    ret = 1;
+  }
+  if (!toStdout) {
+    bool ok = ret == 0 && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+      if (ret == 0) {
+        std::cerr << "write " << path << " failed" << std::endl;
+      }
+      unlink(tmp.c_str());
+      return 1;
+    }
+  }
+  if (ret != 0) {
+    return 1;
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  double mb = out.written() / 1048576.0;
+  std::fprintf(stderr, "exported %zu graphs, %llu records, %.1f MB in %.2fs, %.1f MB/s\n", ids.size(),
+               static_cast<unsigned long long>(visitor.records()), mb, seconds, seconds > 0 ? mb / seconds : 0.0);
+  return 0;
+}
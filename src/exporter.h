@@ -0,0 +1,21 @@
+#ifndef GRAPH_EXPORTER_H_
+#define GRAPH_EXPORTER_H_
+
+#include <string>
+
+#include "graph_manager.h"
+
+// Streams graphs as NDJSON, one record per line:
+//   {"type":"graph","id":1,"name":"..."}
+//   {"type":"work","gi":1,"id":2,"content":"...","related_people":[],"status":0,"priority":0,"updated_at":"..."}
+//   {"type":"event","gi":1,"wi":2,"id":3,"content":"...","created_at":"2006-01-02 15:04:05"}
+//   {"type":"relation","gi":1,"id":4,"w1":2,"w2":3,"description":"..."}
+// Records come straight from the DB iterators (see GraphManager::ScanGraph)
+// and go through a fixed-size output buffer, so memory use does not depend
+// on the size of a graph. Event lines carry the fields the importer reads.
+//
+// Exports graph gi, or every graph if gi is 0, to path (- for stdout) and
+// reports the throughput on stderr.
+int ExportGraphs(GraphManager *gm, int gi, const std::string &path);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef GRAPH_FIELDS_H_
+#define GRAPH_FIELDS_H_
+
+#include <string>
+
+// Field descriptors for the records in graph.h. Each list names the fields of
+// a record once, in encoding order, as
+//   F(number, member, "json_key")
+// where number is the field number of the binary codec (see codec.h) and
+// json_key the key in JSON. Works, events and relations of a graph, and the
+// events of a work, are stored under their own keys and are not fields.
+//
+// For every list GRAPH_DEFINE_FIELDS generates, with Name the record name:
+//   ForEachNameField(r, v)     calls v(number, key, r.member) for each field
+//   VisitNameField(r, n, v)    the same for the field numbered n only
+//   VisitNameField(r, key, v)  the same for the field with JSON key key
+//   NameFieldNumber::member    the field number of member
+// The Visit functions return false if there is no such field. The record is
+// a template parameter, so the views in codec.h, which have the same member
+// names, share the descriptors of their record. Codecs pass a visitor with an
+// overload per member type, which the compiler resolves per field, so the
+// generated code is what one would write by hand for each field.
+
+#define GRAPH_GRAPH_FIELDS(F) \
+    F(1, id, "id") \
+    F(2, name, "name")
+
+#define GRAPH_WORK_FIELDS(F) \
+    F(1, id, "id") \
+    F(2, content, "content") \
+    F(3, related_people, "related_people") \
+    F(4, status, "status") \
+    F(5, priority, "priority") \
+    F(6, updatedAt, "updated_at")
+
+#define GRAPH_EVENT_FIELDS(F) \
+    F(1, id, "id") \
+    F(2, content, "content") \
+    F(3, createdAt, "created_at")
+
+#define GRAPH_RELATION_FIELDS(F) \
+    F(1, id, "id") \
+    F(2, w1, "w1") \
+    F(3, w2, "w2") \
+    F(4, description, "description")
+
+#define GRAPH_CHECKPOINT_FIELDS(F) \
+    F(1, id, "id") \
+    F(2, createdAt, "created_at")
+
+#define GRAPH_FIELD_VISIT(number, member, key) v(number, key, r.member);
+#define GRAPH_FIELD_CASE(number, member, key) case number: v(number, key, r.member); return true;
+#define GRAPH_FIELD_KEY(number, member, key) if (k == key) { v(number, key, r.member); return true; }
+#define GRAPH_FIELD_ENUM(number, member, key) member = number,
+
+#define GRAPH_DEFINE_FIELDS(Name, FIELDS) \
+    template <typename R, typename V> \
+    inline void ForEach##Name##Field(R &r, V &&v) { \
+      FIELDS(GRAPH_FIELD_VISIT) \
+    } \
+    template <typename R, typename V> \
+    inline bool Visit##Name##Field(R &r, int n, V &&v) { \
+      switch (n) { \
+        FIELDS(GRAPH_FIELD_CASE) \
+      } \
+      return false; \
+    } \
+    template <typename R, typename V> \
+    inline bool Visit##Name##Field(R &r, const std::string &k, V &&v) { \
+      FIELDS(GRAPH_FIELD_KEY) \
+      return false; \
+    } \
+    struct Name##FieldNumber { \
+        enum { FIELDS(GRAPH_FIELD_ENUM) }; \
+    };
+
+GRAPH_DEFINE_FIELDS(Graph, GRAPH_GRAPH_FIELDS)
+GRAPH_DEFINE_FIELDS(Work, GRAPH_WORK_FIELDS)
+GRAPH_DEFINE_FIELDS(Event, GRAPH_EVENT_FIELDS)
+GRAPH_DEFINE_FIELDS(Relation, GRAPH_RELATION_FIELDS)
+GRAPH_DEFINE_FIELDS(Checkpoint, GRAPH_CHECKPOINT_FIELDS)
+
+#endif
@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "codec.h"
+#include "fts.h"
+#include "keys.h"
+
+static const size_t kMaxTermBytes = 64;
+
+// Decodes one UTF-8 sequence starting at s[*i]; returns -1 on invalid input
+// and always advances *i by at least one byte.
+static int32_t nextCodePoint(const std::string &s, size_t *i) {
+  unsigned char c = s[*i];
+  int len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xe ? 3 : (c >> 3) == 0x1e ? 4 : 0;
+  if (len == 0 || *i + len > s.size()) {
+    (*i)++;
+    return -1;
+  }
+  int32_t cp = len == 1 ? c : c & (0x7f >> len);
+  for (int k = 1; k < len; k++) {
+    unsigned char cc = s[*i + k];
+    if ((cc & 0xc0) != 0x80) {
+      (*i)++;
+      return -1;
+    }
+    cp = (cp << 6) | (cc & 0x3f);
+  }
+  *i += len;
+  return cp;
+}
+
+static bool isCJK(int32_t cp) {
+  return (cp >= 0x3040 && cp <= 0x30ff) ||   // kana
+         (cp >= 0x3400 && cp <= 0x4dbf) ||   // CJK extension A
+         (cp >= 0x4e00 && cp <= 0x9fff) ||   // CJK unified ideographs
+         (cp >= 0xac00 && cp <= 0xd7af) ||   // hangul syllables
+         (cp >= 0xf900 && cp <= 0xfaff) ||   // CJK compatibility ideographs
+         (cp >= 0x20000 && cp <= 0x2ffff);   // CJK extensions B..F
+}
+
+static bool isSeparator(int32_t cp) {
+  if (cp < 0) {
+    return true;
+  }
+  if (cp < 0x80) {
+    return !std::isalnum(cp);
+  }
+  return cp <= 0xbf ||                       // latin-1 punctuation and symbols
+         (cp >= 0x2000 && cp <= 0x2bff) ||   // general punctuation, symbols, arrows
+         (cp >= 0x3000 && cp <= 0x303f) ||   // CJK punctuation
+         (cp >= 0xff00 && cp <= 0xff0f) ||   // fullwidth punctuation
+         (cp >= 0xff1a && cp <= 0xff20) ||
+         (cp >= 0xff3b && cp <= 0xff40) ||
+         (cp >= 0xff5b && cp <= 0xff65);
+}
+
+// Calls word(term) for every word and run(offsets) for every run of CJK
+// characters, offsets holding the byte offset of each character followed by
+// the end of the run.
+template<typename WordFn, typename RunFn>
+static void scan(const std::string &text, WordFn word, RunFn run) {
+  std::string current;
+  std::vector<size_t> offsets;
+  size_t i = 0;
+  for (;;) {
+    bool end = i >= text.size();
+    size_t start = i;
+    int32_t cp = end ? -1 : nextCodePoint(text, &i);
+    bool cjk = cp >= 0 && isCJK(cp);
+    bool sep = !cjk && isSeparator(cp);
+    if ((cjk || sep) && !current.empty()) {
+      word(current);
+      current.clear();
+    }
+    if (!cjk && !offsets.empty()) {
+      offsets.push_back(start);
+      run(offsets);
+      offsets.clear();
+    }
+    if (end) {
+      break;
+    }
+    if (cjk) {
+      offsets.push_back(start);
+    } else if (!sep && current.size() < kMaxTermBytes) {
+      if (cp < 0x80) {
+        current.push_back(static_cast<char>(std::tolower(cp)));
+      } else {
+        current.append(text, start, i - start);
+      }
+    }
+  }
+}
+
+void Tokenize(const std::string &text, std::map<std::string, uint32_t> *terms) {
+  scan(text,
+       [&](const std::string &w) { (*terms)[w]++; },
+       [&](const std::vector<size_t> &offsets) {
+         for (size_t k = 0; k + 1 < offsets.size(); k++) {
+           (*terms)[text.substr(offsets[k], offsets[k + 1] - offsets[k])]++;
+           if (k + 2 < offsets.size()) {
+             (*terms)[text.substr(offsets[k], offsets[k + 2] - offsets[k])]++;
+           }
+         }
+       });
+}
+
+void QueryTerms(const std::string &query, std::vector<std::string> *terms) {
+  scan(query,
+       [&](const std::string &w) { terms->push_back(w); },
+       [&](const std::vector<size_t> &offsets) {
+         if (offsets.size() == 2) {
+           terms->push_back(query.substr(offsets[0], offsets[1] - offsets[0]));
+           return;
+         }
+         for (size_t k = 0; k + 2 < offsets.size(); k++) {
+           terms->push_back(query.substr(offsets[k], offsets[k + 2] - offsets[k]));
+         }
+       });
+  std::sort(terms->begin(), terms->end());
+  terms->erase(std::unique(terms->begin(), terms->end()), terms->end());
+}
+
+void EncodePostings(const std::vector<Posting> &postings, std::string *dst) {
+  PutVarint64(dst, postings.size());
+  DocId last = 0;
+  for (auto &it: postings) {
+    PutVarint64(dst, it.doc - last);
+    PutVarint64(dst, it.tf);
+    last = it.doc;
+  }
+}
+
+bool DecodePostings(leveldb::Slice input, std::vector<Posting> *postings) {
+  uint64_t n;
+  if (!GetVarint64(&input, &n)) {
+    return false;
+  }
+  DocId last = 0;
+  for (uint64_t k = 0; k < n; k++) {
+    uint64_t delta, tf;
+    if (!GetVarint64(&input, &delta) || !GetVarint64(&input, &tf)) {
+      return false;
+    }
+    last += delta;
+    postings->push_back(Posting{last, static_cast<uint32_t>(tf)});
+  }
+  return true;
+}
+
+static bool postingLess(const Posting &p, DocId doc) {
+  return p.doc < doc;
+}
+
+PostingUpdater::Segment *PostingUpdater::locate(const std::string &term, DocId doc, DocId *first) {
+  auto &segments = terms_[term];
+  Segment *found = nullptr;
+  auto it = segments.upper_bound(doc);
+  if (it != segments.begin()) {
+    --it;
+    found = &it->second;
+    *first = it->first;
+  }
+  if (fresh_) {
+    return found;
+  }
+
+  // A segment on disk that starts after the cached one (or any, if nothing
+  // is cached) holds doc instead; load it so later changes see it.
+  std::string prefix = FtsTermPrefix(gi_, term);
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  std::string target = FtsSegmentKey(gi_, term, doc);
+  iterator->Seek(target);
+  if (!iterator->Valid() || iterator->key() != leveldb::Slice(target)) {
+    if (iterator->Valid()) {
+      iterator->Prev();
+    } else {
+      iterator->SeekToLast();
+    }
+  }
+  if (iterator->Valid() && iterator->key().starts_with(prefix)) {
+    DocId diskFirst = ParseFtsSegmentKey(iterator->key());
+    if (found == nullptr || diskFirst > *first) {
+      Segment &segment = segments[diskFirst];
+      segment.dirty = false;
+      DecodePostings(iterator->value(), &segment.postings);
+      found = &segment;
+      *first = diskFirst;
+    }
+  }
+  delete iterator;
+  return found;
+}
+
+void PostingUpdater::Add(DocId doc, const std::string &text) {
+  std::map<std::string, uint32_t> terms;
+  Tokenize(text, &terms);
+  if (terms.empty()) {
+    return;
+  }
+  docs_++;
+  for (auto &term: terms) {
+    DocId first = 0;
+    Segment *segment = locate(term.first, doc, &first);
+    Posting posting{doc, term.second};
+    auto &segments = terms_[term.first];
+    if (segment == nullptr ||
+        (segment->postings.size() >= kMaxSegmentPostings && segment->postings.back().doc < doc)) {
+      Segment &created = segments[doc];
+      created.postings.assign(1, posting);
+      created.dirty = true;
+      continue;
+    }
+    auto &postings = segment->postings;
+    auto it = std::lower_bound(postings.begin(), postings.end(), doc, postingLess);
+    if (it != postings.end() && it->doc == doc) {
+      it->tf = posting.tf;
+    } else {
+      postings.insert(it, posting);
+    }
+    segment->dirty = true;
+    if (postings.size() > kMaxSegmentPostings) {
+      Segment &tail = segments[postings[postings.size() / 2].doc];
+      tail.postings.assign(postings.begin() + postings.size() / 2, postings.end());
+      tail.dirty = true;
+      postings.resize(postings.size() / 2);
+    }
+  }
+}
+
+void PostingUpdater::Remove(DocId doc, const std::string &text) {
+  std::map<std::string, uint32_t> terms;
+  Tokenize(text, &terms);
+  if (terms.empty()) {
+    return;
+  }
+  docs_--;
+  for (auto &term: terms) {
+    DocId first = 0;
+    Segment *segment = locate(term.first, doc, &first);
+    if (segment == nullptr) {
+      continue;
+    }
+    auto &postings = segment->postings;
+    auto it = std::lower_bound(postings.begin(), postings.end(), doc, postingLess);
+    if (it != postings.end() && it->doc == doc) {
+      postings.erase(it);
+      segment->dirty = true;
+    }
+  }
+}
+
+void PostingUpdater::Flush(leveldb::WriteBatch *batch) {
+  std::string value;
+  for (auto &term: terms_) {
+    for (auto &it: term.second) {
+      if (!it.second.dirty) {
+        continue;
+      }
+      std::string key = FtsSegmentKey(gi_, term.first, it.first);
+      if (it.second.postings.empty()) {
+        batch->Delete(key);
+        continue;
+      }
+      // A segment is keyed by its first document; rename it if that changed.
+      DocId first = it.second.postings.front().doc;
+      if (first != it.first) {
+        batch->Delete(key);
+        key = FtsSegmentKey(gi_, term.first, first);
+      }
+      value.clear();
+      EncodePostings(it.second.postings, &value);
+      batch->Put(key, value);
+    }
+  }
+  if (docs_ != 0 || fresh_) {
+    int64_t docs = docs_;
+    if (!fresh_ && db_->Get(leveldb::ReadOptions{}, FtsDocCountKey(gi_), &value).ok()) {
+      docs += std::atoll(value.c_str());
+    }
+    batch->Put(FtsDocCountKey(gi_), std::to_string(docs < 0 ? 0 : docs));
+  }
+  terms_.clear();
+  docs_ = 0;
+}
+
+int SearchIndex(leveldb::DB *db, int gi, const std::string &query, bool works, bool events, size_t limit,
+                std::vector<SearchHit> *hits) {
+  std::vector<std::string> terms;
+  QueryTerms(query, &terms);
+  if (terms.empty()) {
+    return 0;
+  }
+  leveldb::ReadOptions options;
+  options.snapshot = db->GetSnapshot();
+  std::string value;
+  double docs = 1;
+  if (db->Get(options, FtsDocCountKey(gi), &value).ok()) {
+    docs = std::max(1.0, std::atof(value.c_str()));
+  }
+
+  // Intersect the posting lists term by term, accumulating BM25 scores
+  // (k1 = 1.2, no length normalization).
+  const double k1 = 1.2;
+  std::vector<SearchHit> current;
+  std::vector<DocId> currentDocs;
+  auto iterator = db->NewIterator(options);
+  for (size_t t = 0; t < terms.size(); t++) {
+    std::vector<Posting> postings;
+    std::string prefix = FtsTermPrefix(gi, terms[t]);
+    for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+      DecodePostings(iterator->value(), &postings);
+    }
+    double df = postings.size();
+    double idf = std::log(1 + (docs - df + 0.5) / (df + 0.5));
+    std::vector<SearchHit> next;
+    std::vector<DocId> nextDocs;
+    size_t j = 0;
+    for (auto &p: postings) {
+      bool isWork = DocEvent(p.doc) == 0;
+      if ((isWork && !works) || (!isWork && !events)) {
+        continue;
+      }
+      double score = idf * p.tf * (k1 + 1) / (p.tf + k1);
+      if (t == 0) {
+        next.push_back(SearchHit{DocWork(p.doc), DocEvent(p.doc), score, std::string()});
+        nextDocs.push_back(p.doc);
+        continue;
+      }
+      while (j < currentDocs.size() && currentDocs[j] < p.doc) {
+        j++;
+      }
+      if (j < currentDocs.size() && currentDocs[j] == p.doc) {
+        next.push_back(current[j]);
+        next.back().score += score;
+        nextDocs.push_back(p.doc);
+      }
+    }
+    current.swap(next);
+    currentDocs.swap(nextDocs);
+    if (current.empty()) {
+      break;
+    }
+  }
+  delete iterator;
+  db->ReleaseSnapshot(options.snapshot);
+
+  std::stable_sort(current.begin(), current.end(), [](const SearchHit &a, const SearchHit &b) {
+    return a.score > b.score;
+  });
+  if (current.size() > limit) {
+    current.resize(limit);
+  }
+  hits->swap(current);
+  return 0;
+}
@@ -0,0 +1,95 @@
+#ifndef GRAPH_FTS_H_
+#define GRAPH_FTS_H_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "leveldb/db.h"
+#include "leveldb/write_batch.h"
+
+// Full-text index over work and event content.
+//
+// Documents are identified by (work id, event id), event id 0 being the
+// work itself. For every term of a graph the postings (document, term
+// frequency) are kept sorted by document and split into segments of at
+// most kMaxSegmentPostings entries, each stored under
+// fts-<gi>-<term>\0<first document> as delta + varint encoded pairs. Adding
+// or removing a document rewrites one small segment per term.
+
+typedef uint64_t DocId;
+
+inline DocId WorkDoc(int wi) { return static_cast<DocId>(wi) << 32; }
+
+inline DocId EventDoc(int wi, int ei) { return (static_cast<DocId>(wi) << 32) | static_cast<uint32_t>(ei); }
+
+inline int DocWork(DocId doc) { return static_cast<int>(doc >> 32); }
+
+inline int DocEvent(DocId doc) { return static_cast<int>(doc & 0xffffffff); }
+
+struct Posting {
+    DocId doc;
+    uint32_t tf;
+};
+
+// Splits text into index terms with their frequencies. ASCII letters and
+// digits form lowercased words, other non-CJK letters are kept as is, and
+// runs of CJK characters are indexed as single characters and bigrams.
+void Tokenize(const std::string &text, std::map<std::string, uint32_t> *terms);
+
+// Splits a query the same way, but uses only bigrams for CJK runs longer
+// than one character so that every term must match.
+void QueryTerms(const std::string &query, std::vector<std::string> *terms);
+
+void EncodePostings(const std::vector<Posting> &postings, std::string *dst);
+
+bool DecodePostings(leveldb::Slice input, std::vector<Posting> *postings);
+
+// Collects the posting changes of one write. Several documents touching the
+// same term in one WriteBatch see each other's changes because segments are
+// read once and kept in memory until Flush.
+class PostingUpdater {
+public:
+    // A fresh updater assumes the graph has no index yet (its keys are being
+    // deleted in the same batch) and never reads existing segments.
+    PostingUpdater(leveldb::DB *db, int gi, bool fresh = false) : db_(db), gi_(gi), fresh_(fresh), docs_(0) {};
+
+    void Add(DocId doc, const std::string &text);
+
+    void Remove(DocId doc, const std::string &text);
+
+    // Writes every changed segment and the document count into batch.
+    void Flush(leveldb::WriteBatch *batch);
+
+private:
+    static const size_t kMaxSegmentPostings = 256;
+
+    struct Segment {
+        std::vector<Posting> postings;
+        bool dirty;
+    };
+
+    leveldb::DB *db_;
+    int gi_;
+    bool fresh_;
+    int64_t docs_;
+    // term -> first document of segment -> segment
+    std::map<std::string, std::map<DocId, Segment>> terms_;
+
+    Segment *locate(const std::string &term, DocId doc, DocId *first);
+};
+
+// ei is 0 when the hit is the work itself.
+struct SearchHit {
+    int wi;
+    int ei;
+    double score;
+    std::string content;
+};
+
+// Returns documents containing every query term, best BM25 score first.
+int SearchIndex(leveldb::DB *db, int gi, const std::string &query, bool works, bool events, size_t limit,
+                std::vector<SearchHit> *hits);
+
+#endif
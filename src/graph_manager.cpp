@@ -0,0 +1,1353 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <memory>
+
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "codec.h"
+#include "fts.h"
+#include "graph_manager.h"
+#include "json_records.h"
+#include "keys.h"
+#include "util.h"
+
+
+GraphManager::~GraphManager() {
+  delete staged_;
+  delete owned_;
+}
+
+void GraphManager::BeginBatch() {
+  if (staged_ == nullptr) {
+    staged_ = new StagedDB(owned_);
+    db_ = staged_;
+  }
+}
+
+int GraphManager::CommitBatch() {
+  if (staged_ == nullptr) {
+    return 0;
+  }
+  auto status = staged_->Commit(leveldb::WriteOptions{});
+  delete staged_;
+  staged_ = nullptr;
+  db_ = owned_;
+  // Checkpoints created or deleted by the batch are lost if it failed.
+  latestCheckpoints_.clear();
+  if (!status.ok()) {
+    std::cerr << "write failed: " << status.ToString() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+namespace {
+
+// Collects the final state of every graph record key a batch touches.
+class RecordCollector : public leveldb::WriteBatch::Handler {
+public:
+    std::map<std::string, StagedDB::Entry> changes;
+
+    void Put(const leveldb::Slice &key, const leveldb::Slice &value) override {
+      int gi;
+      if (ParseRecordGraph(key, &gi)) {
+        changes[key.ToString()] = StagedDB::Entry{false, value.ToString()};
+      }
+    }
+
+    void Delete(const leveldb::Slice &key) override {
+      int gi;
+      if (ParseRecordGraph(key, &gi)) {
+        changes[key.ToString()] = StagedDB::Entry{true, std::string()};
+      }
+    }
+};
+
+}  // namespace
+
+int GraphManager::write(leveldb::WriteBatch *batch, bool versioned) {
+  if (versioned && preserve(batch) != 0) {
+    return 1;
+  }
+  auto status = db_->Write(leveldb::WriteOptions{}, batch);
+  if (!status.ok()) {
+    std::cerr << "write failed: " << status.ToString() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int GraphManager::preserve(leveldb::WriteBatch *batch) {
+  RecordCollector records;
+  auto status = batch->Iterate(&records);
+  if (!status.ok()) {
+    std::cerr << "read batch failed: " << status.ToString() << std::endl;
+    return 1;
+  }
+  std::map<int, int> latest;
+  std::string value, saved;
+  for (auto &it: records.changes) {
+    int gi;
+    ParseRecordGraph(it.first, &gi);
+    auto ci = latest.find(gi);
+    if (ci == latest.end()) {
+      ci = latest.insert(std::make_pair(gi, LatestCheckpoint(gi))).first;
+    }
+    if (ci->second == 0) {
+      continue;
+    }
+    // Only the first change after a checkpoint is saved.
+    std::string cow = CowKey(gi, it.first, ci->second);
+    if (db_->Get(leveldb::ReadOptions{}, cow, &saved).ok()) {
+      continue;
+    }
+    status = db_->Get(leveldb::ReadOptions{}, it.first, &value);
+    if (status.ok()) {
+      if (!it.second.deleted && it.second.value == value) {
+        continue;
+      }
+      saved.assign(1, kCowPresent);
+      saved.append(value);
+    } else if (status.IsNotFound()) {
+      if (it.second.deleted) {
+        continue;
+      }
+      saved.assign(1, kCowAbsent);
+    } else {
+      std::cerr << "read " << it.first << " failed: " << status.ToString() << std::endl;
+      return 1;
+    }
+    batch->Put(cow, saved);
+    batch->Put(CowCheckpointKey(gi, ci->second, it.first), leveldb::Slice());
+  }
+  return 0;
+}
+
+void GraphManager::deletePrefix(const std::string &prefix, leveldb::WriteBatch *batch) {
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    batch->Delete(iterator->key());
+  }
+  delete iterator;
+}
+
+bool GraphManager::lastKey(const std::string &prefix, std::string *key) {
+  std::string limit = prefix;
+  limit.push_back('\xff');
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  iterator->Seek(limit);
+  if (iterator->Valid()) {
+    iterator->Prev();
+  } else {
+    iterator->SeekToLast();
+  }
+  bool found = iterator->Valid() && iterator->key().starts_with(prefix);
+  if (found) {
+    *key = iterator->key().ToString();
+  }
+  delete iterator;
+  return found;
+}
+
+int GraphManager::reserveIds(const std::string &seqKey, const std::string &idPrefix, int count,
+                             leveldb::WriteBatch *batch, int *first) {
+  std::string value;
+  int last = 0;
+  auto status = db_->Get(leveldb::ReadOptions{}, seqKey, &value);
+  if (status.ok()) {
+    last = std::atoi(value.c_str());
+  } else if (status.IsNotFound()) {
+    std::string key;
+    if (lastKey(idPrefix, &key)) {
+      last = ParseTrailingId(key);
+    }
+  } else {
+    std::cerr << "read " << seqKey << " failed: " << status.ToString() << std::endl;
+    return 1;
+  }
+  *first = last + 1;
+  batch->Put(seqKey, std::to_string(last + count));
+  return 0;
+}
+
+int GraphManager::Migrate() {
+  std::string layout;
+  auto status = db_->Get(leveldb::ReadOptions{}, kMetaLayout, &layout);
+  if (status.ok() && layout == kLayoutVersion) {
+    return 0;
+  }
+  if (!status.ok() && !status.IsNotFound()) {
+    std::cerr << "read layout failed: " << status.ToString() << std::endl;
+    return 1;
+  }
+  int version = status.ok() ? std::atoi(layout.c_str()) : 1;
+  if (version < 3) {
+    if (migrateBlobs() != 0) {
+      return 1;
+    }
+    const std::string prefixes[] = {kGraphPrefix, kWorkPrefix, kEventPrefix, kRelationPrefix};
+    for (auto &prefix: prefixes) {
+      if (migrateRecords(prefix) != 0) {
+        return 1;
+      }
+    }
+  }
+  if (version < 4 && migrateEventTimeIndex() != 0) {
+    return 1;
+  }
+  if (version < 5 && migrateWorkIndex() != 0) {
+    return 1;
+  }
+  if (version < 6 && migrateFullText() != 0) {
+    return 1;
+  }
+  if (version < 7 && migrateEventCounts() != 0) {
+    return 1;
+  }
+  if (version < 8 && migrateCowIndex() != 0) {
+    return 1;
+  }
+  status = db_->Put(leveldb::WriteOptions{}, kMetaLayout, kLayoutVersion);
+  if (!status.ok()) {
+    std::cerr << "write layout failed: " << status.ToString() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int GraphManager::migrateBlobs() {
+  std::vector<std::string> legacy;
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  for (iterator->Seek(kGraphPrefix); iterator->Valid() && iterator->key().starts_with(kGraphPrefix); iterator->Next()) {
+    if (IsLegacyGraphKey(iterator->key())) {
+      legacy.push_back(iterator->key().ToString());
+    }
+  }
+  delete iterator;
+
+  for (auto &key: legacy) {
+    std::string value;
+    auto status = db_->Get(leveldb::ReadOptions{}, key, &value);
+    if (!status.ok()) {
+      std::cerr << "read " << key << " failed: " << status.ToString() << std::endl;
+      return 1;
+    }
+    Graph g;
+    std::string err;
+    if (!ParseGraphJson(value, &g, &err)) {
+      std::cerr << "parse record failed: " << err << std::endl;
+      return 1;
+    }
+    leveldb::WriteBatch batch;
+    batch.Delete(key);
+    putGraph(&g, &batch);
+    if (write(&batch) != 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int GraphManager::migrateRecords(const std::string &prefix) {
+  const size_t kMaxBatch = 1000;
+  leveldb::WriteBatch batch;
+  size_t pending = 0;
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    if (IsBinaryRecord(iterator->value())) {
+      continue;
+    }
+    std::string data = iterator->value().ToString();
+    std::string value, err;
+    bool ok;
+    if (prefix == kGraphPrefix) {
+      Graph graph;
+      ok = ParseGraphJson(data, &graph, &err);
+      EncodeGraph(graph, &value);
+    } else if (prefix == kWorkPrefix) {
+      Work work = Work{};
+      ok = ParseWorkJson(data, &work, &err);
+      EncodeWork(work, &value);
+    } else if (prefix == kEventPrefix) {
+      Event event = Event{};
+      ok = ParseEventJson(data, &event, &err);
+      EncodeEvent(event, &value);
+    } else {
+      Relation relation = Relation{};
+      ok = ParseRelationJson(data, &relation, &err);
+      EncodeRelation(relation, &value);
+    }
+    if (!ok) {
+      // Leave the layout version alone so the record is not dropped; the
+      // batches written so far are kept and skipped on the next run.
+      std::cerr << "parse record " << iterator->key().ToString() << " failed: " << err << std::endl;
+      delete iterator;
+      return 1;
+    }
+    batch.Put(iterator->key(), value);
+    if (++pending >= kMaxBatch) {
+      if (write(&batch) != 0) {
+        delete iterator;
+        return 1;
+      }
+      batch.Clear();
+      pending = 0;
+    }
+  }
+  delete iterator;
+  return pending > 0 ? write(&batch) : 0;
+}
+
+int GraphManager::migrateEventTimeIndex() {
+  const size_t kMaxBatch = 1000;
+  leveldb::WriteBatch batch;
+  size_t pending = 0;
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  for (iterator->Seek(kEventPrefix); iterator->Valid() && iterator->key().starts_with(kEventPrefix); iterator->Next()) {
+    int gi, wi, ei;
+    Event event = Event{};
+    if (!ParseEventKey(iterator->key(), &gi, &wi, &ei) || !DecodeEvent(iterator->value(), &event)) {
+      continue;
+    }
+    indexEvent(gi, wi, event, &batch);
+    if (++pending >= kMaxBatch) {
+      if (write(&batch) != 0) {
+        delete iterator;
+        return 1;
+      }
+      batch.Clear();
+      pending = 0;
+    }
+  }
+  delete iterator;
+  return pending > 0 ? write(&batch) : 0;
+}
+
+int GraphManager::migrateWorkIndex() {
+  const size_t kMaxBatch = 1000;
+  leveldb::WriteBatch batch;
+  size_t pending = 0;
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  for (iterator->Seek(kWorkPrefix); iterator->Valid() && iterator->key().starts_with(kWorkPrefix); iterator->Next()) {
+    int gi, wi;
+    Work work = Work{};
+    if (!ParseWorkKey(iterator->key(), &gi, &wi) || !DecodeWork(iterator->value(), &work)) {
+      continue;
+    }
+    indexWork(gi, work, &batch);
+    if (++pending >= kMaxBatch) {
+      if (write(&batch) != 0) {
+        delete iterator;
+        return 1;
+      }
+      batch.Clear();
+      pending = 0;
+    }
+  }
+  delete iterator;
+  return pending > 0 ? write(&batch) : 0;
+}
+
+int GraphManager::migrateFullText() {
+  std::vector<int> ids;
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  for (iterator->Seek(kGraphPrefix); iterator->Valid() && iterator->key().starts_with(kGraphPrefix); iterator->Next()) {
+    ids.push_back(ParseTrailingId(iterator->key()));
+  }
+  delete iterator;
+
+  for (int gi: ids) {
+    if (RebuildFullText(gi) != 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int GraphManager::migrateEventCounts() {
+  const size_t kMaxBatch = 1000;
+  leveldb::WriteBatch batch;
+  size_t pending = 0;
+  // Events are ordered by work, so each count is complete when the next work
+  // starts.
+  int lastGraph = 0, lastWork = 0, count = 0;
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  for (iterator->Seek(kEventPrefix);; iterator->Next()) {
+    bool valid = iterator->Valid() && iterator->key().starts_with(kEventPrefix);
+    int gi = 0, wi = 0, ei;
+    if (valid && !ParseEventKey(iterator->key(), &gi, &wi, &ei)) {
+      continue;
+    }
+    if (count > 0 && (!valid || gi != lastGraph || wi != lastWork)) {
+      batch.Put(EventCountKey(lastGraph, lastWork), std::to_string(count));
+      count = 0;
+      if (++pending >= kMaxBatch) {
+        if (write(&batch) != 0) {
+          delete iterator;
+          return 1;
+        }
+        batch.Clear();
+        pending = 0;
+      }
+    }
+    if (!valid) {
+      break;
+    }
+    lastGraph = gi;
+    lastWork = wi;
+    count++;
+  }
+  delete iterator;
+  return pending > 0 ? write(&batch) : 0;
+}
+
+int GraphManager::migrateCowIndex() {
+  const size_t kMaxBatch = 1000;
+  leveldb::WriteBatch batch;
+  size_t pending = 0;
+  std::string key;
+  int gi, ci;
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  for (iterator->Seek(kCowPrefix); iterator->Valid() && iterator->key().starts_with(kCowPrefix); iterator->Next()) {
+    if (!ParseCowKey(iterator->key(), &key, &ci) || !ParseRecordGraph(key, &gi)) {
+      continue;
+    }
+    batch.Put(CowCheckpointKey(gi, ci, key), leveldb::Slice());
+    if (++pending >= kMaxBatch) {
+      if (write(&batch, false) != 0) {
+        delete iterator;
+        return 1;
+      }
+      batch.Clear();
+      pending = 0;
+    }
+  }
+  delete iterator;
+  return pending > 0 ? write(&batch, false) : 0;
+}
+
+int GraphManager::RebuildFullText(int gi) {
+  leveldb::WriteBatch batch;
+  deletePrefix(FtsPrefix(gi), &batch);
+  PostingUpdater fts(db_, gi, true);
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  std::string prefix = WorkPrefix(gi);
+  for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    Work work = Work{};
+    if (DecodeWork(iterator->value(), &work)) {
+      fts.Add(WorkDoc(work.id), work.content);
+    }
+  }
+  prefix = EventPrefix(gi);
+  for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    int egi, wi, ei;
+    Event event = Event{};
+    if (ParseEventKey(iterator->key(), &egi, &wi, &ei) && DecodeEvent(iterator->value(), &event)) {
+      fts.Add(EventDoc(wi, ei), event.content);
+    }
+  }
+  delete iterator;
+  fts.Flush(&batch);
+  return write(&batch);
+}
+
+void GraphManager::indexWork(int gi, const Work &work, leveldb::WriteBatch *batch) {
+  batch->Put(WorkStatusKey(gi, work.status, work.id), leveldb::Slice());
+  batch->Put(WorkPriorityKey(gi, work.priority, work.id), leveldb::Slice());
+  for (auto &it: work.related_people) {
+    batch->Put(WorkPersonKey(gi, it, work.id), leveldb::Slice());
+  }
+}
+
+void GraphManager::unindexWork(int gi, const Work &work, leveldb::WriteBatch *batch) {
+  batch->Delete(WorkStatusKey(gi, work.status, work.id));
+  batch->Delete(WorkPriorityKey(gi, work.priority, work.id));
+  for (auto &it: work.related_people) {
+    batch->Delete(WorkPersonKey(gi, it, work.id));
+  }
+}
+
+void GraphManager::indexEvent(int gi, int wi, const Event &event, leveldb::WriteBatch *batch) {
+  batch->Put(EventTimeKey(gi, event.createdAt, wi, event.id), leveldb::Slice());
+}
+
+void GraphManager::unindexEvent(int gi, int wi, const Event &event, leveldb::WriteBatch *batch) {
+  batch->Delete(EventTimeKey(gi, event.createdAt, wi, event.id));
+}
+
+void GraphManager::addEventCount(int gi, int wi, int delta, leveldb::WriteBatch *batch) {
+  batch->Put(EventCountKey(gi, wi), std::to_string(CountEvents(gi, wi) + delta));
+}
+
+void GraphManager::deleteEvents(int gi, int wi, PostingUpdater *fts, leveldb::WriteBatch *batch) {
+  std::string prefix = EventPrefix(gi, wi);
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    Event event = Event{};
+    if (DecodeEvent(iterator->value(), &event)) {
+      unindexEvent(gi, wi, event, batch);
+      fts->Remove(EventDoc(wi, event.id), event.content);
+    }
+    batch->Delete(iterator->key());
+  }
+  delete iterator;
+}
+
+// Positions iterator at the first key after key. Ids are zero-padded, so this
+// is the record after the one with the id in key.
+static void seekAfter(leveldb::Iterator *iterator, const std::string &key) {
+  iterator->Seek(key);
+  if (iterator->Valid() && iterator->key() == key) {
+    iterator->Next();
+  }
+}
+
+int GraphManager::ScanGraphs(const std::function<int(const GraphView &graph)> &fn, int after) {
+  GraphView view;
+  int ret = 0;
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  for (seekAfter(iterator, GraphKey(after)); ret == 0 && iterator->Valid() && iterator->key().starts_with(kGraphPrefix);
+       iterator->Next()) {
+    if (DecodeGraphView(iterator->value(), &view)) {
+      ret = fn(view);
+    }
+  }
+  delete iterator;
+  return ret;
+}
+
+int GraphManager::ListGraph(std::vector<Graph *> *graphs) {
+  return ScanGraphs([graphs](const GraphView &view) {
+    Graph *graph = new Graph;
+    graph->id = view.id;
+    graph->name = view.name.ToString();
+    graphs->push_back(graph);
+    return 0;
+  });
+}
+
+std::string GraphManager::DumpGraph(Graph *graph) {
+  std::string data;
+  DumpGraphJson(*graph, &data);
+  return data;
+}
+
+int GraphManager::ScanGraph(int gi, GraphVisitor *visitor) {
+  leveldb::ReadOptions options;
+  options.snapshot = db_->GetSnapshot();
+  options.fill_cache = false;
+  std::string value;
+  Graph graph;
+  if (!db_->Get(options, GraphKey(gi), &value).ok() || !DecodeGraph(value, &graph)) {
+    db_->ReleaseSnapshot(options.snapshot);
+    return -1;
+  }
+  int ret = visitor->VisitGraph(graph);
+  auto iterator = db_->NewIterator(options);
+  std::string prefix = WorkPrefix(gi);
+  for (iterator->Seek(prefix); ret == 0 && iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    Work work = Work{};
+    if (DecodeWork(iterator->value(), &work)) {
+      ret = visitor->VisitWork(gi, work);
+    }
+  }
+  prefix = EventPrefix(gi);
+  for (iterator->Seek(prefix); ret == 0 && iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    int egi, wi, ei;
+    Event event = Event{};
+    if (ParseEventKey(iterator->key(), &egi, &wi, &ei) && DecodeEvent(iterator->value(), &event)) {
+      ret = visitor->VisitEvent(gi, wi, event);
+    }
+  }
+  prefix = RelationPrefix(gi);
+  for (iterator->Seek(prefix); ret == 0 && iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    Relation relation;
+    if (DecodeRelation(iterator->value(), &relation)) {
+      ret = visitor->VisitRelation(gi, relation);
+    }
+  }
+  if (ret == 0 && !iterator->status().ok()) {
+    std::cerr << "read graph " << gi << " failed: " << iterator->status().ToString() << std::endl;
+    ret = 1;
+  }
+  delete iterator;
+  db_->ReleaseSnapshot(options.snapshot);
+  return ret;
+}
+
+void GraphManager::putGraph(Graph *graph, leveldb::WriteBatch *batch) {
+  std::string value;
+  EncodeGraph(*graph, &value);
+  batch->Put(GraphKey(graph->id), value);
+  PostingUpdater fts(db_, graph->id, true);
+  for (auto &it: graph->works) {
+    value.clear();
+    EncodeWork(it.second, &value);
+    batch->Put(WorkKey(graph->id, it.second.id), value);
+    indexWork(graph->id, it.second, batch);
+    fts.Add(WorkDoc(it.second.id), it.second.content);
+    for (auto &it1: it.second.events) {
+      value.clear();
+      EncodeEvent(it1, &value);
+      batch->Put(EventKey(graph->id, it.second.id, it1.id), value);
+      indexEvent(graph->id, it.second.id, it1, batch);
+      fts.Add(EventDoc(it.second.id, it1.id), it1.content);
+    }
+    batch->Put(EventCountKey(graph->id, it.second.id), std::to_string(it.second.events.size()));
+  }
+  fts.Flush(batch);
+  for (auto &it: graph->relations) {
+    value.clear();
+    EncodeRelation(it.second, &value);
+    batch->Put(RelationKey(graph->id, it.second.id), value);
+  }
+}
+
+int GraphManager::CreateGraph(Graph *graph) {
+  leveldb::WriteBatch batch;
+  if (reserveIds(GraphSeqKey(), kGraphPrefix, 1, &batch, &graph->id) != 0) {
+    return 1;
+  }
+  putGraph(graph, &batch);
+  return write(&batch);
+}
+
+int GraphManager::CreateWork(int gi, Work *work) {
+  if (!HasGraph(gi)) {
+    return -1;
+  }
+  leveldb::WriteBatch batch;
+  if (reserveIds(WorkSeqKey(gi), WorkPrefix(gi), 1, &batch, &work->id) != 0) {
+    return 1;
+  }
+  std::string value;
+  EncodeWork(*work, &value);
+  batch.Put(WorkKey(gi, work->id), value);
+  indexWork(gi, *work, &batch);
+  PostingUpdater fts(db_, gi);
+  fts.Add(WorkDoc(work->id), work->content);
+  fts.Flush(&batch);
+  return write(&batch);
+}
+
+int GraphManager::CreateEvent(int gi, int wi, Event *event) {
+  std::vector<Event> events(1, *event);
+  int ret = CreateEvents(gi, wi, &events);
+  event->id = events[0].id;
+  return ret;
+}
+
+int GraphManager::CreateEvents(int gi, int wi, std::vector<Event> *events) {
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions{}, WorkKey(gi, wi), &value);
+  if (!status.ok()) {
+    return -1;
+  }
+  leveldb::WriteBatch batch;
+  int first;
+  if (reserveIds(EventSeqKey(gi, wi), EventPrefix(gi, wi), events->size(), &batch, &first) != 0) {
+    return 1;
+  }
+  PostingUpdater fts(db_, gi);
+  for (auto &it: *events) {
+    it.id = first++;
+    value.clear();
+    EncodeEvent(it, &value);
+    batch.Put(EventKey(gi, wi, it.id), value);
+    indexEvent(gi, wi, it, &batch);
+    fts.Add(EventDoc(wi, it.id), it.content);
+  }
+  addEventCount(gi, wi, static_cast<int>(events->size()), &batch);
+  fts.Flush(&batch);
+  return write(&batch);
+}
+
+int GraphManager::SaveGraph(Graph *graph) {
+  leveldb::WriteBatch batch;
+  deletePrefix(WorkPrefix(graph->id), &batch);
+  deletePrefix(EventPrefix(graph->id), &batch);
+  deletePrefix(EventTimePrefix(graph->id), &batch);
+  deletePrefix(EventCountPrefix(graph->id), &batch);
+  deletePrefix(WorkIndexPrefix(graph->id), &batch);
+  deletePrefix(RelationPrefix(graph->id), &batch);
+  deletePrefix(FtsPrefix(graph->id), &batch);
+  putGraph(graph, &batch);
+  return write(&batch);
+}
+
+int GraphManager::GetGraph(Graph *g, int gi) {
+  return getGraph(leveldb::ReadOptions{}, g, gi);
+}
+
+int GraphManager::MultiGetGraph(const std::vector<int> &ids, std::vector<Graph> *graphs) {
+  leveldb::ReadOptions options;
+  options.snapshot = db_->GetSnapshot();
+  int ret = 0;
+  graphs->clear();
+  graphs->reserve(ids.size());
+  for (int gi: ids) {
+    graphs->push_back(Graph{});
+    if (getGraph(options, &graphs->back(), gi) != 0) {
+      graphs->pop_back();
+      ret = -1;
+    }
+  }
+  db_->ReleaseSnapshot(options.snapshot);
+  return ret;
+}
+
+bool GraphManager::HasGraph(int gi) {
+  std::string k = GraphKey(gi);
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  iterator->Seek(k);
+  bool found = iterator->Valid() && iterator->key() == k;
+  delete iterator;
+  return found;
+}
+
+bool GraphManager::HasWork(int gi, int wi) {
+  std::string k = WorkKey(gi, wi);
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  iterator->Seek(k);
+  bool found = iterator->Valid() && iterator->key() == k;
+  delete iterator;
+  return found;
+}
+
+int GraphManager::getGraph(const leveldb::ReadOptions &options, Graph *g, int gi) {
+  std::string value;
+  auto status = db_->Get(options, GraphKey(gi), &value);
+  if (!status.ok()) {
+    return -1;
+  }
+  if (!DecodeGraph(value, g)) {
+    return -1;
+  }
+
+  auto iterator = db_->NewIterator(options);
+  std::string prefix = WorkPrefix(gi);
+  for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    Work work = Work{};
+    if (DecodeWork(iterator->value(), &work)) {
+      g->works[kWorkPrefix + std::to_string(work.id)] = work;
+    }
+  }
+
+  prefix = EventPrefix(gi);
+  for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    int egi, wi, ei;
+    if (!ParseEventKey(iterator->key(), &egi, &wi, &ei)) {
+      continue;
+    }
+    auto work = g->works.find(kWorkPrefix + std::to_string(wi));
+    Event event = Event{};
+    if (work != g->works.end() && DecodeEvent(iterator->value(), &event)) {
+      work->second.events.push_back(event);
+    }
+  }
+
+  prefix = RelationPrefix(gi);
+  for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    Relation relation;
+    if (DecodeRelation(iterator->value(), &relation)) {
+      g->relations[kRelationPrefix + std::to_string(relation.id)] = relation;
+    }
+  }
+  delete iterator;
+  return 0;
+}
+
+int GraphManager::ScanWork(int gi, int wi, const std::function<int(const WorkView &work)> &workFn,
+                           const std::function<int(const EventView &event)> &eventFn, uint32_t workFields,
+                           uint32_t eventFields, int afterEvent) {
+  leveldb::ReadOptions options;
+  options.snapshot = db_->GetSnapshot();
+  std::string value;
+  WorkView work;
+  int ret = -1;
+  if (db_->Get(options, WorkKey(gi, wi), &value).ok() && DecodeWorkView(value, &work, workFields)) {
+    ret = workFn(work);
+  }
+  if (ret == 0) {
+    EventView event;
+    std::string prefix = EventPrefix(gi, wi);
+    auto iterator = db_->NewIterator(options);
+    for (seekAfter(iterator, EventKey(gi, wi, afterEvent));
+         ret == 0 && iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+      if (DecodeEventView(iterator->value(), &event, eventFields)) {
+        ret = eventFn(event);
+      }
+    }
+    delete iterator;
+  }
+  db_->ReleaseSnapshot(options.snapshot);
+  return ret;
+}
+
+int GraphManager::GetWork(int gi, int wi, Work *work) {
+  return ScanWork(gi, wi, [work](const WorkView &view) {
+    MaterializeWork(view, work);
+    return 0;
+  }, [work](const EventView &view) {
+    work->events.push_back(Event{});
+    MaterializeEvent(view, &work->events.back());
+    return 0;
+  });
+}
+
+int GraphManager::SaveWork(int gi, Work *work) {
+  leveldb::WriteBatch batch;
+  std::string value;
+  Work old = Work{};
+  PostingUpdater fts(db_, gi);
+  auto status = db_->Get(leveldb::ReadOptions{}, WorkKey(gi, work->id), &value);
+  bool found = status.ok() && DecodeWork(value, &old);
+  if (found) {
+    unindexWork(gi, old, &batch);
+  }
+  if (!found || old.content != work->content) {
+    if (found) {
+      fts.Remove(WorkDoc(work->id), old.content);
+    }
+    fts.Add(WorkDoc(work->id), work->content);
+  }
+  value.clear();
+  EncodeWork(*work, &value);
+  batch.Put(WorkKey(gi, work->id), value);
+  indexWork(gi, *work, &batch);
+  fts.Flush(&batch);
+  return write(&batch);
+}
+
+bool WorkFilter::Matches(const Work &work) const {
+  if (status >= 0 && work.status != status) {
+    return false;
+  }
+  if (minPriority != kAnyPriority && work.priority < minPriority) {
+    return false;
+  }
+  return person.empty() ||
+         std::find(work.related_people.begin(), work.related_people.end(), person) != work.related_people.end();
+}
+
+void GraphManager::collectWorkIds(const std::string &seek, const std::string &prefix, bool *filtered,
+                                  std::vector<int> *ids) {
+  std::vector<int> found;
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  for (iterator->Seek(seek); iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    found.push_back(ParseTrailingId(iterator->key()));
+  }
+  delete iterator;
+  std::sort(found.begin(), found.end());
+  if (*filtered) {
+    std::vector<int> both;
+    std::set_intersection(ids->begin(), ids->end(), found.begin(), found.end(), std::back_inserter(both));
+    ids->swap(both);
+  } else {
+    ids->swap(found);
+  }
+  *filtered = true;
+}
+
+int GraphManager::ScanWorks(int gi, const WorkFilter &filter, const std::function<int(const WorkView &work)> &fn,
+                            uint32_t fields, int after) {
+  if (!HasGraph(gi)) {
+    return -1;
+  }
+  std::vector<int> ids;
+  bool filtered = false;
+  if (filter.status >= 0) {
+    std::string prefix = WorkStatusPrefix(gi, filter.status);
+    collectWorkIds(prefix, prefix, &filtered, &ids);
+  }
+  if (filter.minPriority != WorkFilter::kAnyPriority) {
+    collectWorkIds(WorkPrioritySeekKey(gi, filter.minPriority), WorkPriorityPrefix(gi), &filtered, &ids);
+  }
+  if (!filter.person.empty()) {
+    std::string prefix = WorkPersonPrefix(gi, filter.person);
+    collectWorkIds(prefix, prefix, &filtered, &ids);
+  }
+
+  WorkView work;
+  int ret = 0;
+  if (!filtered) {
+    std::string prefix = WorkPrefix(gi);
+    auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+    for (seekAfter(iterator, WorkKey(gi, after)); ret == 0 && iterator->Valid() && iterator->key().starts_with(prefix);
+         iterator->Next()) {
+      if (DecodeWorkView(iterator->value(), &work, fields)) {
+        ret = fn(work);
+      }
+    }
+    delete iterator;
+    return ret;
+  }
+
+  std::string value;
+  for (size_t i = std::upper_bound(ids.begin(), ids.end(), after) - ids.begin(); ret == 0 && i < ids.size(); i++) {
+    if (db_->Get(leveldb::ReadOptions{}, WorkKey(gi, ids[i]), &value).ok() && DecodeWorkView(value, &work, fields)) {
+      ret = fn(work);
+    }
+  }
+  return ret;
+}
+
+int GraphManager::ListWork(int gi, const WorkFilter &filter, std::vector<Work> *works) {
+  return ScanWorks(gi, filter, [works](const WorkView &view) {
+    works->push_back(Work{});
+    MaterializeWork(view, &works->back());
+    return 0;
+  });
+}
+
+int GraphManager::CountEvents(int gi, int wi) {
+  std::string value;
+  return db_->Get(leveldb::ReadOptions{}, EventCountKey(gi, wi), &value).ok() ? std::atoi(value.c_str()) : 0;
+}
+
+int GraphManager::DeleteWork(int gi, int wi) {
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions{}, WorkKey(gi, wi), &value);
+  if (!status.ok()) {
+    return -1;
+  }
+  leveldb::WriteBatch batch;
+  PostingUpdater fts(db_, gi);
+  Work work = Work{};
+  if (DecodeWork(value, &work)) {
+    unindexWork(gi, work, &batch);
+    fts.Remove(WorkDoc(wi), work.content);
+  }
+  batch.Delete(WorkKey(gi, wi));
+  batch.Delete(EventSeqKey(gi, wi));
+  batch.Delete(EventCountKey(gi, wi));
+  deleteEvents(gi, wi, &fts, &batch);
+  fts.Flush(&batch);
+  return write(&batch);
+}
+
+int GraphManager::SaveEvent(int gi, int wi, Event *event) {
+  leveldb::WriteBatch batch;
+  std::string value;
+  Event old = Event{};
+  PostingUpdater fts(db_, gi);
+  auto status = db_->Get(leveldb::ReadOptions{}, EventKey(gi, wi, event->id), &value);
+  bool found = status.ok() && DecodeEvent(value, &old);
+  if (found) {
+    unindexEvent(gi, wi, old, &batch);
+  } else {
+    addEventCount(gi, wi, 1, &batch);
+  }
+  if (!found || old.content != event->content) {
+    if (found) {
+      fts.Remove(EventDoc(wi, event->id), old.content);
+    }
+    fts.Add(EventDoc(wi, event->id), event->content);
+  }
+  value.clear();
+  EncodeEvent(*event, &value);
+  batch.Put(EventKey(gi, wi, event->id), value);
+  indexEvent(gi, wi, *event, &batch);
+  fts.Flush(&batch);
+  return write(&batch);
+}
+
+int GraphManager::DeleteEvent(int gi, int wi, int ei) {
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions{}, EventKey(gi, wi, ei), &value);
+  if (!status.ok()) {
+    return -1;
+  }
+  leveldb::WriteBatch batch;
+  Event event = Event{};
+  if (DecodeEvent(value, &event)) {
+    unindexEvent(gi, wi, event, &batch);
+    PostingUpdater fts(db_, gi);
+    fts.Remove(EventDoc(wi, ei), event.content);
+    fts.Flush(&batch);
+  }
+  batch.Delete(EventKey(gi, wi, ei));
+  addEventCount(gi, wi, -1, &batch);
+  return write(&batch);
+}
+
+int GraphManager::ListEventSince(int gi, int64_t since,
+                                 const std::function<int(const WorkView &work, const EventView &event)> &fn,
+                                 EventCursor *cursor) {
+  std::string prefix = EventTimePrefix(gi);
+  leveldb::ReadOptions options;
+  options.snapshot = db_->GetSnapshot();
+  auto iterator = db_->NewIterator(options);
+  std::string seek = EventTimeSeekKey(gi, since);
+  if (cursor != nullptr && cursor->wi != 0) {
+    seek = std::max(seek, EventTimeKey(gi, cursor->createdAt, cursor->wi, cursor->ei));
+  }
+  // Only the work of the last event is kept; events of a work are often
+  // created together, so it is rarely read again.
+  std::string workValue, value;
+  WorkView work;
+  EventView event;
+  int workId = 0;
+  int ret = 0;
+  for (seekAfter(iterator, seek); ret == 0 && iterator->Valid() && iterator->key().starts_with(prefix);
+       iterator->Next()) {
+    int egi, wi, ei;
+    int64_t createdAt;
+    if (!ParseEventTimeKey(iterator->key(), &egi, &createdAt, &wi, &ei)) {
+      continue;
+    }
+    if (wi != workId) {
+      workId = 0;
+      if (!db_->Get(options, WorkKey(gi, wi), &workValue).ok() ||
+          !DecodeWorkView(workValue, &work, kWorkFieldId | kWorkFieldContent)) {
+        continue;
+      }
+      workId = wi;
+    }
+    if (!db_->Get(options, EventKey(gi, wi, ei), &value).ok() || !DecodeEventView(value, &event, kEventFieldsAll)) {
+      continue;
+    }
+    ret = fn(work, event);
+    if (ret == 0 && cursor != nullptr) {
+      cursor->createdAt = createdAt;
+      cursor->wi = wi;
+      cursor->ei = ei;
+    }
+  }
+  if (ret == 0 && cursor != nullptr) {
+    cursor->wi = 0;
+  }
+  delete iterator;
+  db_->ReleaseSnapshot(options.snapshot);
+  return ret;
+}
+
+int GraphManager::DeleteGraph(int id) {
+  if (!HasGraph(id)) {
+    return -1;
+  }
+  leveldb::WriteBatch batch;
+  batch.Delete(GraphKey(id));
+  deletePrefix(WorkPrefix(id), &batch);
+  deletePrefix(EventPrefix(id), &batch);
+  deletePrefix(EventTimePrefix(id), &batch);
+  deletePrefix(EventCountPrefix(id), &batch);
+  deletePrefix(WorkIndexPrefix(id), &batch);
+  deletePrefix(RelationPrefix(id), &batch);
+  deletePrefix(FtsPrefix(id), &batch);
+  batch.Delete(FtsDocCountKey(id));
+  batch.Delete(WorkSeqKey(id));
+  deletePrefix(kSeqPrefix + EventPrefix(id), &batch);
+  deletePrefix(CheckpointPrefix(id), &batch);
+  deletePrefix(CowPrefix(id), &batch);
+  deletePrefix(CowCheckpointPrefix(id), &batch);
+  batch.Delete(CheckpointSeqKey(id));
+  latestCheckpoints_.erase(id);
+  // The checkpoints go away with the graph, so nothing needs to be saved.
+  return write(&batch, false);
+}
+
+int GraphManager::Search(int gi, const std::string &query, bool works, bool events, size_t limit,
+                         std::vector<SearchHit> *hits) {
+  if (!HasGraph(gi)) {
+    return -1;
+  }
+  if (SearchIndex(db_, gi, query, works, events, limit, hits) != 0) {
+    return 1;
+  }
+  std::string value;
+  for (auto &it: *hits) {
+    if (it.ei == 0) {
+      Work work = Work{};
+      if (db_->Get(leveldb::ReadOptions{}, WorkKey(gi, it.wi), &value).ok() && DecodeWork(value, &work)) {
+        it.content = work.content;
+      }
+    } else {
+      Event event = Event{};
+      if (db_->Get(leveldb::ReadOptions{}, EventKey(gi, it.wi, it.ei), &value).ok() && DecodeEvent(value, &event)) {
+        it.content = event.content;
+      }
+    }
+  }
+  return 0;
+}
+
+int GraphManager::ImportEvents(const std::string &source, const std::string &progress,
+                               std::map<std::pair<int, int>, std::vector<Event>> *works) {
+  leveldb::WriteBatch batch;
+  // works is ordered by graph, so one updater at a time is enough.
+  std::unique_ptr<PostingUpdater> fts;
+  int ftsGraph = 0;
+  int ci = 0;
+  std::string value;
+  for (auto it = works->begin(); it != works->end(); it++) {
+    int gi = it->first.first;
+    int wi = it->first.second;
+    if (!HasWork(gi, wi)) {
+      return -1;
+    }
+    if (fts == nullptr || gi != ftsGraph) {
+      if (fts != nullptr) {
+        fts->Flush(&batch);
+      }
+      fts.reset(new PostingUpdater(db_, gi));
+      ftsGraph = gi;
+      ci = LatestCheckpoint(gi);
+    }
+    int first;
+    if (reserveIds(EventSeqKey(gi, wi), EventPrefix(gi, wi), it->second.size(), &batch, &first) != 0) {
+      return 1;
+    }
+    for (auto &event: it->second) {
+      event.id = first++;
+      std::string key = EventKey(gi, wi, event.id);
+      value.clear();
+      EncodeEvent(event, &value);
+      batch.Put(key, value);
+      indexEvent(gi, wi, event, &batch);
+      fts->Add(EventDoc(wi, event.id), event.content);
+      // Events imported after a checkpoint did not exist as of it.
+      if (ci != 0) {
+        batch.Put(CowKey(gi, key, ci), leveldb::Slice(&kCowAbsent, 1));
+        batch.Put(CowCheckpointKey(gi, ci, key), leveldb::Slice());
+      }
+    }
+    addEventCount(gi, wi, static_cast<int>(it->second.size()), &batch);
+  }
+  if (fts != nullptr) {
+    fts->Flush(&batch);
+  }
+  batch.Put(ImportProgressKey(source), progress);
+  // The new keys are recorded in the checkpoint above, without reading them.
+  return write(&batch, false);
+}
+
+bool GraphManager::GetImportProgress(const std::string &source, std::string *progress) {
+  return db_->Get(leveldb::ReadOptions{}, ImportProgressKey(source), progress).ok();
+}
+
+bool GraphManager::HasImport(const std::string &source) {
+  std::string value;
+  return db_->Get(leveldb::ReadOptions{}, ImportKey(source), &value).ok();
+}
+
+int GraphManager::FinishImport(const std::string &source) {
+  leveldb::WriteBatch batch;
+  batch.Delete(ImportProgressKey(source));
+  batch.Put(ImportKey(source), leveldb::Slice());
+  return write(&batch, false);
+}
+
+int GraphManager::LatestCheckpoint(int gi) {
+  auto it = latestCheckpoints_.find(gi);
+  if (it != latestCheckpoints_.end()) {
+    return it->second;
+  }
+  std::string key;
+  int ci = lastKey(CheckpointPrefix(gi), &key) ? ParseTrailingId(key) : 0;
+  latestCheckpoints_[gi] = ci;
+  return ci;
+}
+
+int GraphManager::GenerateGraphCheckpoint(int gi, int *ci) {
+  if (!HasGraph(gi)) {
+    return -1;
+  }
+  leveldb::WriteBatch batch;
+  Checkpoint checkpoint = Checkpoint{};
+  if (reserveIds(CheckpointSeqKey(gi), CheckpointPrefix(gi), 1, &batch, &checkpoint.id) != 0) {
+    return 1;
+  }
+  checkpoint.createdAt = nowMicros();
+  std::string value;
+  EncodeCheckpoint(checkpoint, &value);
+  batch.Put(CheckpointKey(gi, checkpoint.id), value);
+  *ci = checkpoint.id;
+  int ret = write(&batch);
+  latestCheckpoints_.erase(gi);
+  return ret;
+}
+
+int GraphManager::ListGraphCheckpoint(int gi, std::vector<Checkpoint> *checkpoints, int after) {
+  if (!HasGraph(gi)) {
+    return -1;
+  }
+  std::string prefix = CheckpointPrefix(gi);
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  for (seekAfter(iterator, CheckpointKey(gi, after)); iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    Checkpoint checkpoint = Checkpoint{};
+    if (DecodeCheckpoint(iterator->value(), &checkpoint)) {
+      checkpoints->push_back(checkpoint);
+    }
+  }
+  delete iterator;
+  return 0;
+}
+
+int GraphManager::DeleteGraphCheckpoint(int gi, int ci) {
+  std::string value;
+  if (!db_->Get(leveldb::ReadOptions{}, CheckpointKey(gi, ci), &value).ok()) {
+    return -1;
+  }
+  leveldb::WriteBatch batch;
+  batch.Delete(CheckpointKey(gi, ci));
+
+  std::string prefix = CheckpointPrefix(gi);
+  int previous = 0;
+  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
+  iterator->Seek(CheckpointKey(gi, ci));
+  iterator->Prev();
+  if (iterator->Valid() && iterator->key().starts_with(prefix)) {
+    previous = ParseTrailingId(iterator->key());
+  }
+
+  // A value saved under ci is also the value as of the previous checkpoint
+  // unless the key changed in between, in which case that change saved it
+  // under the previous checkpoint already.
+  prefix = CowCheckpointPrefix(gi, ci);
+  std::string key, saved;
+  for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    key.assign(iterator->key().data() + prefix.size(), iterator->key().size() - prefix.size());
+    std::string cow = CowKey(gi, key, ci);
+    batch.Delete(iterator->key());
+    batch.Delete(cow);
+    if (previous != 0) {
+      std::string moved = CowKey(gi, key, previous);
+      if (!db_->Get(leveldb::ReadOptions{}, moved, &value).ok() &&
+          db_->Get(leveldb::ReadOptions{}, cow, &saved).ok()) {
+        batch.Put(moved, saved);
+        batch.Put(CowCheckpointKey(gi, previous, key), leveldb::Slice());
+      }
+    }
+  }
+  delete iterator;
+  latestCheckpoints_.erase(gi);
+  return write(&batch, false);
+}
+
+void GraphManager::scanAsOf(const leveldb::ReadOptions &options, int gi, int ci, const std::string &prefix,
+                            const std::function<void(const leveldb::Slice &key, const leveldb::Slice &value)> &fn) {
+  // Saved values of a key are ordered by checkpoint, so the first one at or
+  // after ci is the value the key had at ci.
+  std::map<std::string, std::string> saved;
+  std::string cowPrefix = CowPrefix(gi) + prefix;
+  std::string key;
+  int sci;
+  auto iterator = db_->NewIterator(options);
+  for (iterator->Seek(cowPrefix); iterator->Valid() && iterator->key().starts_with(cowPrefix); iterator->Next()) {
+    if (ParseCowKey(iterator->key(), &key, &sci) && sci >= ci) {
+      saved.insert(std::make_pair(key, iterator->value().ToString()));
+    }
+  }
+  for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix); iterator->Next()) {
+    if (saved.empty() || saved.find(iterator->key().ToString()) == saved.end()) {
+      fn(iterator->key(), iterator->value());
+    }
+  }
+  delete iterator;
+  for (auto &it: saved) {
+    if (!it.second.empty() && it.second[0] == kCowPresent) {
+      fn(it.first, leveldb::Slice(it.second.data() + 1, it.second.size() - 1));
+    }
+  }
+}
+
+static bool eventLess(const Event &a, const Event &b) {
+  return a.id < b.id;
+}
+
+int GraphManager::getGraphAsOf(const leveldb::ReadOptions &options, int gi, int ci, Graph *g) {
+  std::string value;
+  if (!db_->Get(options, CheckpointKey(gi, ci), &value).ok()) {
+    return -1;
+  }
+  bool found = false;
+  scanAsOf(options, gi, ci, GraphKey(gi), [&](const leveldb::Slice &, const leveldb::Slice &v) {
+    found = DecodeGraph(v, g);
+  });
+  if (!found) {
+    return -1;
+  }
+  scanAsOf(options, gi, ci, WorkPrefix(gi), [&](const leveldb::Slice &, const leveldb::Slice &v) {
+    Work work = Work{};
+    if (DecodeWork(v, &work)) {
+      g->works[kWorkPrefix + std::to_string(work.id)] = work;
+    }
+  });
+  scanAsOf(options, gi, ci, EventPrefix(gi), [&](const leveldb::Slice &k, const leveldb::Slice &v) {
+    int egi, wi, ei;
+    if (!ParseEventKey(k, &egi, &wi, &ei)) {
+      return;
+    }
+    auto work = g->works.find(kWorkPrefix + std::to_string(wi));
+    Event event = Event{};
+    if (work != g->works.end() && DecodeEvent(v, &event)) {
+      work->second.events.push_back(event);
+    }
+  });
+  for (auto &it: g->works) {
+    std::sort(it.second.events.begin(), it.second.events.end(), eventLess);
+  }
+  scanAsOf(options, gi, ci, RelationPrefix(gi), [&](const leveldb::Slice &, const leveldb::Slice &v) {
+    Relation relation;
+    if (DecodeRelation(v, &relation)) {
+      g->relations[kRelationPrefix + std::to_string(relation.id)] = relation;
+    }
+  });
+  return 0;
+}
+
+int GraphManager::GetGraphAsOf(int gi, int ci, Graph *g) {
+  leveldb::ReadOptions options;
+  options.snapshot = db_->GetSnapshot();
+  int ret = getGraphAsOf(options, gi, ci, g);
+  db_->ReleaseSnapshot(options.snapshot);
+  return ret;
+}
+
+int GraphManager::GetWorkAsOf(int gi, int wi, int ci, Work *work) {
+  leveldb::ReadOptions options;
+  options.snapshot = db_->GetSnapshot();
+  std::string value;
+  bool found = false;
+  if (db_->Get(options, CheckpointKey(gi, ci), &value).ok()) {
+    scanAsOf(options, gi, ci, WorkKey(gi, wi), [&](const leveldb::Slice &, const leveldb::Slice &v) {
+      found = DecodeWork(v, work);
+    });
+  }
+  if (found) {
+    scanAsOf(options, gi, ci, EventPrefix(gi, wi), [&](const leveldb::Slice &, const leveldb::Slice &v) {
+      Event event = Event{};
+      if (DecodeEvent(v, &event)) {
+        work->events.push_back(event);
+      }
+    });
+    std::sort(work->events.begin(), work->events.end(), eventLess);
+  }
+  db_->ReleaseSnapshot(options.snapshot);
+  return found ? 0 : -1;
+}
+
+int GraphManager::ListWorkAsOf(int gi, int ci, const WorkFilter &filter, std::vector<Work> *works) {
+  Graph g;
+  if (GetGraphAsOf(gi, ci, &g) != 0) {
+    return -1;
+  }
+  for (auto &it: g.works) {
+    if (filter.Matches(it.second)) {
+      works->push_back(it.second);
+    }
+  }
+  std::sort(works->begin(), works->end(), [](const Work &a, const Work &b) { return a.id < b.id; });
+  return 0;
+}
+
+int GraphManager::RestoreGraphCheckpoint(int gi, int ci) {
+  Graph g;
+  if (GetGraphAsOf(gi, ci, &g) != 0) {
+    return -1;
+  }
+  return SaveGraph(&g);
+}
@@ -0,0 +1,288 @@
+#ifndef GRAPH_GRAPH_MANAGER_H_
+#define GRAPH_GRAPH_MANAGER_H_
+
+#include <limits.h>
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "leveldb/db.h"
+#include "leveldb/write_batch.h"
+#include "codec.h"
+#include "fts.h"
+#include "graph.h"
+#include "staged_db.h"
+
+// WorkFilter selects works through the secondary indexes. Criteria left at
+// their defaults match every work; set criteria are combined with AND.
+struct WorkFilter {
+    static const int kAnyPriority = INT_MIN;
+
+    int status = -1;
+    int minPriority = kAnyPriority;
+    std::string person;
+
+    // Evaluates the filter on a decoded work, for reads that can not use the
+    // indexes.
+    bool Matches(const Work &work) const;
+};
+
+// A position in the event time index of a graph, see ListEventSince. wi is 0
+// before the first event.
+struct EventCursor {
+    int64_t createdAt = 0;
+    int wi = 0;
+    int ei = 0;
+};
+
+// Receives the records of a graph one at a time, see GraphManager::ScanGraph.
+// Returning non-zero from a Visit method stops the scan.
+class GraphVisitor {
+public:
+    virtual ~GraphVisitor() {}
+
+    virtual int VisitGraph(const Graph &graph) = 0;
+
+    virtual int VisitWork(int gi, const Work &work) = 0;
+
+    virtual int VisitEvent(int gi, int wi, const Event &event) = 0;
+
+    virtual int VisitRelation(int gi, const Relation &relation) = 0;
+};
+
+class GraphManager {
+public:
+    GraphManager(leveldb::DB *db) : db_(db), owned_(db), staged_(nullptr) {};
+
+    ~GraphManager();
+
+    // Upgrades older storage layouts: graphs stored as one JSON blob are split
+    // into per-entity keys, and per-entity JSON records are re-encoded in the
+    // binary record format. Work is committed in small batches, so an
+    // interrupted migration simply resumes on the next open.
+    int Migrate();
+
+    // Between BeginBatch and CommitBatch writes are staged in memory instead
+    // of being applied; reads see them, and CommitBatch applies everything
+    // with a single WriteBatch.
+    void BeginBatch();
+
+    int CommitBatch();
+
+    // The Scan* methods pass records to fn as views (see codec.h) that are
+    // valid only during the call, so nothing is copied unless fn does.
+    // Returning non-zero from fn stops the scan and is returned. Scans that
+    // take after start behind that id, so a listing can be continued from
+    // the last record it showed.
+
+    // Visits every graph header.
+    int ScanGraphs(const std::function<int(const GraphView &graph)> &fn, int after = 0);
+
+    // Lists graph headers only; works and relations are not loaded.
+    int ListGraph(std::vector<Graph *> *graphs);
+
+    int DeleteGraph(int id);
+
+    int GetGraph(Graph *graph, int gi);
+
+    // Loads several graphs from one consistent snapshot. Graphs that do not
+    // exist are skipped and -1 is returned.
+    int MultiGetGraph(const std::vector<int> &ids, std::vector<Graph> *graphs);
+
+    // Checks that the graph header exists without reading or decoding it.
+    bool HasGraph(int gi);
+
+    bool HasWork(int gi, int wi);
+
+    // Create* assign the next id from a persisted per-DB (graphs), per-graph
+    // (works) or per-work (events) sequence. The sequence is advanced in the
+    // same WriteBatch as the insert, so ids are never handed out twice.
+    int CreateGraph(Graph *graph);
+
+    int CreateWork(int gi, Work *work);
+
+    int CreateEvent(int gi, int wi, Event *event);
+
+    // Inserts all events with a single block reservation and one write.
+    int CreateEvents(int gi, int wi, std::vector<Event> *events);
+
+    // Rewrites every entity of the graph, dropping works, events and
+    // relations that are no longer present in graph.
+    int SaveGraph(Graph *graph);
+
+    // Visits a work and then its events in id order, from the event after
+    // afterEvent; returns -1 if the work does not exist. The field masks (see
+    // codec.h) limit what is decoded.
+    int ScanWork(int gi, int wi, const std::function<int(const WorkView &work)> &workFn,
+                 const std::function<int(const EventView &event)> &eventFn,
+                 uint32_t workFields = kWorkFieldsAll, uint32_t eventFields = kEventFieldsAll, int afterEvent = 0);
+
+    // Loads a single work together with its events.
+    int GetWork(int gi, int wi, Work *work);
+
+    // Writes the work record only; its events are stored separately.
+    int SaveWork(int gi, Work *work);
+
+    int DeleteWork(int gi, int wi);
+
+    // Visits works (without events) ordered by id, answering filters from
+    // the status, priority and related-people indexes.
+    int ScanWorks(int gi, const WorkFilter &filter, const std::function<int(const WorkView &work)> &fn,
+                  uint32_t fields = kWorkFieldsAll, int after = 0);
+
+    int ListWork(int gi, const WorkFilter &filter, std::vector<Work> *works);
+
+    // Returns the number of events of a work, which every write that adds or
+    // deletes events keeps up to date in the same batch.
+    int CountEvents(int gi, int wi);
+
+    int SaveEvent(int gi, int wi, Event *event);
+
+    int DeleteEvent(int gi, int wi, int ei);
+
+    // Streams the events of a graph created at or after since (epoch
+    // microseconds) to fn in time index order, each with its work decoded to
+    // id and content only. Cost is proportional to the number of events
+    // passed. A non-zero return of fn stops the scan and is returned.
+    //
+    // cursor, if set, skips the events up to and including it, and is left
+    // at the last event fn accepted, or with wi 0 if no events are left.
+    int ListEventSince(int gi, int64_t since,
+                       const std::function<int(const WorkView &work, const EventView &event)> &fn,
+                       EventCursor *cursor = nullptr);
+
+    // Full-text search over work and/or event content of a graph; hits come
+    // with their content filled in.
+    int Search(int gi, const std::string &query, bool works, bool events, size_t limit,
+               std::vector<SearchHit> *hits);
+
+    // Rebuilds the full-text index of a graph from its works and events.
+    int RebuildFullText(int gi);
+
+    // Used by the bulk importer (see importer.h). ImportEvents adds the
+    // events of one input chunk, keyed by (graph, work), with a single
+    // WriteBatch that also reserves their ids, indexes them, marks them
+    // absent in the newest checkpoint and stores progress for source, so a
+    // chunk is imported together with the progress that skips it on resume.
+    // Returns -1, writing nothing, if one of the works does not exist.
+    int ImportEvents(const std::string &source, const std::string &progress,
+                     std::map<std::pair<int, int>, std::vector<Event>> *works);
+
+    // Reads the progress stored by ImportEvents; false if there is none.
+    bool GetImportProgress(const std::string &source, std::string *progress);
+
+    bool HasImport(const std::string &source);
+
+    // Marks source as imported and drops its progress.
+    int FinishImport(const std::string &source);
+
+    // Checkpoints are copy-on-write: creating one only writes its header, so
+    // the cost does not depend on the size of the graph. Afterwards the first
+    // write to a graph, work, event or relation key saves the value it
+    // replaces under the newest checkpoint (cow-<gi>-<key>\0<ci>). The graph as
+    // of checkpoint ci is the current graph with every key replaced by its
+    // saved value of the oldest checkpoint >= ci.
+    int GenerateGraphCheckpoint(int gi, int *ci);
+
+    // Lists the checkpoints of a graph after checkpoint after, oldest first.
+    int ListGraphCheckpoint(int gi, std::vector<Checkpoint> *checkpoints, int after = 0);
+
+    // Saved values that the previous checkpoint still needs are moved to it.
+    int DeleteGraphCheckpoint(int gi, int ci);
+
+    // Returns the newest checkpoint of a graph, or 0 if it has none. The
+    // answer is cached until a checkpoint of the graph is created or deleted.
+    int LatestCheckpoint(int gi);
+
+    // Loads the graph as it was when checkpoint ci was created.
+    int GetGraphAsOf(int gi, int ci, Graph *graph);
+
+    // Loads a work with its events as of checkpoint ci.
+    int GetWorkAsOf(int gi, int wi, int ci, Work *work);
+
+    // Lists the works matching filter as of checkpoint ci, with their events.
+    int ListWorkAsOf(int gi, int ci, const WorkFilter &filter, std::vector<Work> *works);
+
+    // Rewrites the graph to its state at checkpoint ci. Checkpoints are kept,
+    // so a restore can itself be undone from a later checkpoint.
+    int RestoreGraphCheckpoint(int gi, int ci);
+
+    // Streams the header, works, events and relations of a graph to visitor
+    // from one snapshot, decoding a single record at a time. Works and
+    // events arrive ordered by id, all works before the first event.
+    int ScanGraph(int gi, GraphVisitor *visitor);
+
+    // Serializes the whole graph as JSON; used for export only.
+    std::string DumpGraph(Graph *graph);
+
+
+private:
+    // db_ is the staged view during a batch and owned_ otherwise.
+    leveldb::DB *db_;
+    leveldb::DB *owned_;
+    StagedDB *staged_;
+    // Newest checkpoint per graph, see LatestCheckpoint.
+    std::map<int, int> latestCheckpoints_;
+
+    // Applies batch, first adding the values it replaces to the newest
+    // checkpoint of their graph unless versioned is false.
+    int write(leveldb::WriteBatch *batch, bool versioned = true);
+
+    int preserve(leveldb::WriteBatch *batch);
+
+    // Calls fn for every key under prefix of graph gi as of checkpoint ci.
+    void scanAsOf(const leveldb::ReadOptions &options, int gi, int ci, const std::string &prefix,
+                  const std::function<void(const leveldb::Slice &key, const leveldb::Slice &value)> &fn);
+
+    int getGraphAsOf(const leveldb::ReadOptions &options, int gi, int ci, Graph *graph);
+
+    int migrateBlobs();
+
+    int migrateRecords(const std::string &prefix);
+
+    int migrateEventTimeIndex();
+
+    int migrateWorkIndex();
+
+    int migrateFullText();
+
+    int migrateEventCounts();
+
+    int migrateCowIndex();
+
+    void indexWork(int gi, const Work &work, leveldb::WriteBatch *batch);
+
+    void unindexWork(int gi, const Work &work, leveldb::WriteBatch *batch);
+
+    // Intersects ids with the work ids found in [seek, end of prefix).
+    void collectWorkIds(const std::string &seek, const std::string &prefix, bool *filtered,
+                        std::vector<int> *ids);
+
+    void indexEvent(int gi, int wi, const Event &event, leveldb::WriteBatch *batch);
+
+    void unindexEvent(int gi, int wi, const Event &event, leveldb::WriteBatch *batch);
+
+    // Adds delta to the event count of a work in batch.
+    void addEventCount(int gi, int wi, int delta, leveldb::WriteBatch *batch);
+
+    // Deletes the events of a work together with their index entries.
+    void deleteEvents(int gi, int wi, PostingUpdater *fts, leveldb::WriteBatch *batch);
+
+    int getGraph(const leveldb::ReadOptions &options, Graph *graph, int gi);
+
+    // Reserves count consecutive ids from the sequence stored under seqKey
+    // and records the new high-water mark in batch. Sequences written before
+    // the allocator existed are seeded from the last key under idPrefix.
+    int reserveIds(const std::string &seqKey, const std::string &idPrefix, int count,
+                   leveldb::WriteBatch *batch, int *first);
+
+    bool lastKey(const std::string &prefix, std::string *key);
+
+    void deletePrefix(const std::string &prefix, leveldb::WriteBatch *batch);
+
+    void putGraph(Graph *graph, leveldb::WriteBatch *batch);
+};
+
+#endif
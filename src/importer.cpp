@@ -0,0 +1,308 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <thread>
+
+#include "importer.h"
+#include "json11.hpp"
+#include "util.h"
+
+// Every chunk is written as one WriteBatch, which leveldb holds in memory
+// while it is applied.
+static const size_t kChunkBytes = 16 << 20;
+static const int kMaxReportedErrors = 10;
+
+namespace {
+
+struct Row {
+    int gi;
+    int wi;
+    Event event;
+    uint64_t line;
+    std::string err;
+};
+
+// How much of the input has been imported, stored with every chunk.
+struct Progress {
+    uint64_t offset = 0;
+    uint64_t lines = 0;
+    uint64_t events = 0;
+};
+
+}  // namespace
+
+static std::string sourceId(const std::string &path) {
+  uint64_t h = 14695981039346656037ULL;
+  for (unsigned char c: path) {
+    h = (h ^ c) * 1099511628211ULL;
+  }
+  char buf[17];
+  std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+  return buf;
+}
+
+static std::string encodeProgress(const Progress &p) {
+  char buf[64];
+  int n = std::snprintf(buf, sizeof(buf), "%llu %llu %llu", static_cast<unsigned long long>(p.offset),
+                        static_cast<unsigned long long>(p.lines), static_cast<unsigned long long>(p.events));
+  return std::string(buf, n);
+}
+
+static bool decodeProgress(const std::string &s, Progress *p) {
+  unsigned long long offset, lines, events;
+  if (std::sscanf(s.c_str(), "%llu %llu %llu", &offset, &lines, &events) != 3) {
+    return false;
+  }
+  p->offset = offset;
+  p->lines = lines;
+  p->events = events;
+  return true;
+}
+
+// A missing created_at means now.
+static bool parseCreatedAt(const std::string &s, int64_t *us) {
+  if (s.empty()) {
+    *us = nowMicros();
+    return true;
+  }
+  return parseTime(s.c_str(), us);
+}
+
+// doc is reused across rows so that parsing allocates only while its buffers grow.
+static bool parseJsonRow(const std::string &line, Row *row, json11::JsonDocument *doc) {
+  std::string err;
+  if (!doc->parse(line, err)) {
+    row->err = err;
+    return false;
+  }
+  auto json = doc->root();
+  if (!json["gi"].is_number() || !json["wi"].is_number() || !json["content"].is_string()) {
+    row->err = "gi, wi and content are required";
+    return false;
+  }
+  row->gi = json["gi"].int_value();
+  row->wi = json["wi"].int_value();
+  row->event.content = json["content"].string_value().str();
+  if (!parseCreatedAt(json["created_at"].string_value().str(), &row->event.createdAt)) {
+    row->err = "bad created_at";
+    return false;
+  }
+  return true;
+}
+
+// Splits one CSV record; quoted fields may contain commas and "" escapes but
+// no line breaks.
+static bool splitCsv(const std::string &line, std::vector<std::string> *fields) {
+  std::string field;
+  bool quoted = false;
+  for (size_t i = 0; i < line.size(); i++) {
+    char c = line[i];
+    if (quoted) {
+      if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+        field.push_back('"');
+        i++;
+      } else if (c == '"') {
+        quoted = false;
+      } else {
+        field.push_back(c);
+      }
+    } else if (c == '"') {
+      quoted = true;
+    } else if (c == ',') {
+      fields->push_back(field);
+      field.clear();
+    } else {
+      field.push_back(c);
+    }
+  }
+  fields->push_back(field);
+  return !quoted;
+}
+
+static bool parseCsvRow(const std::string &line, Row *row) {
+  std::vector<std::string> fields;
+  if (!splitCsv(line, &fields) || fields.size() < 3 || fields.size() > 4) {
+    row->err = "expected gi,wi,content[,created_at]";
+    return false;
+  }
+  char *end;
+  row->gi = static_cast<int>(std::strtol(fields[0].c_str(), &end, 10));
+  if (fields[0].empty() || *end != '\0') {
+    row->err = "bad gi";
+    return false;
+  }
+  row->wi = static_cast<int>(std::strtol(fields[1].c_str(), &end, 10));
+  if (fields[1].empty() || *end != '\0') {
+    row->err = "bad wi";
+    return false;
+  }
+  row->event.content = fields[2];
+  if (!parseCreatedAt(fields.size() == 4 ? fields[3] : "", &row->event.createdAt)) {
+    row->err = "bad created_at";
+    return false;
+  }
+  return true;
+}
+
+// Runs fn(begin, end) over [0, n) split across threads.
+template<typename Fn>
+static void parallelFor(size_t n, int threads, Fn fn) {
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; t++) {
+    workers.emplace_back(fn, n * t / threads, n * (t + 1) / threads);
+  }
+  fn(0, n / threads);
+  for (auto &it: workers) {
+    it.join();
+  }
+}
+
+// Parses one chunk of input and imports its events, together with the
+// progress past the chunk, in one write.
+static int importChunk(GraphManager *gm, const std::string &source, const std::string &data, bool csv,
+                       int threads, Progress *p, uint64_t *skipped) {
+  std::vector<Row> rows;
+  size_t start = 0;
+  uint64_t line = p->lines;
+  while (start < data.size()) {
+    size_t end = data.find('\n', start);
+    if (end == std::string::npos) {
+      end = data.size();
+    }
+    line++;
+    size_t len = end - start;
+    if (len > 0 && data[start + len - 1] == '\r') {
+      len--;
+    }
+    bool header = csv && line == 1 && len > 0 && !std::isdigit(static_cast<unsigned char>(data[start]));
+    if (len > 0 && !header) {
+      rows.push_back(Row{});
+      rows.back().line = line;
+      rows.back().event.content.assign(data, start, len);
+    }
+    start = end + 1;
+  }
+
+  parallelFor(rows.size(), threads, [&rows, csv](size_t begin, size_t end) {
+    json11::JsonDocument doc;
+    for (size_t i = begin; i < end; i++) {
+      std::string text;
+      text.swap(rows[i].event.content);
+      if (csv) {
+        parseCsvRow(text, &rows[i]);
+      } else {
+        parseJsonRow(text, &rows[i], &doc);
+      }
+    }
+  });
+
+  // Events are numbered per work in input order.
+  std::map<std::pair<int, int>, std::vector<Event>> works;
+  std::map<std::pair<int, int>, bool> exists;
+  Progress next = *p;
+  next.offset += data.size();
+  next.lines = line;
+  for (auto &it: rows) {
+    if (!it.err.empty()) {
+      continue;
+    }
+    auto work = std::make_pair(it.gi, it.wi);
+    auto found = exists.find(work);
+    if (found == exists.end()) {
+      found = exists.insert(std::make_pair(work, gm->HasWork(it.gi, it.wi))).first;
+    }
+    if (!found->second) {
+      it.err = "work not found";
+      continue;
+    }
+    works[work].push_back(std::move(it.event));
+    next.events++;
+  }
+  for (auto &it: rows) {
+    if (!it.err.empty() && (*skipped)++ < kMaxReportedErrors) {
+      std::cerr << "line " << it.line << ": " << it.err << std::endl;
+    }
+  }
+  if (gm->ImportEvents(source, encodeProgress(next), &works) != 0) {
+    std::cerr << "import failed at line " << p->lines + 1 << std::endl;
+    return 1;
+  }
+  *p = next;
+  return 0;
+}
+
+int ImportEvents(GraphManager *gm, const std::string &path, int threads) {
+  char resolved[PATH_MAX];
+  if (realpath(path.c_str(), resolved) == nullptr) {
+    std::cerr << "open " << path << " failed" << std::endl;
+    return 1;
+  }
+  std::string source = sourceId(resolved);
+  if (gm->HasImport(source)) {
+    std::cout << "already imported" << std::endl;
+    return 0;
+  }
+  Progress p;
+  std::string saved;
+  if (gm->GetImportProgress(source, &saved) && !decodeProgress(saved, &p)) {
+    std::cerr << "bad progress of the import of " << path << std::endl;
+    return 1;
+  }
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+
+  std::FILE *in = std::fopen(resolved, "rb");
+  if (in == nullptr) {
+    std::cerr << "open " << path << " failed" << std::endl;
+    return 1;
+  }
+  fseeko(in, 0, SEEK_END);
+  uint64_t size = ftello(in);
+  if (p.offset > 0) {
+    std::cerr << "resuming at line " << p.lines + 1 << std::endl;
+  }
+  auto started = std::chrono::steady_clock::now();
+  uint64_t importedBefore = p.events;
+  uint64_t skipped = 0;
+  std::string data;
+  while (p.offset < size) {
+    data.resize(std::min<uint64_t>(kChunkBytes, size - p.offset));
+    fseeko(in, p.offset, SEEK_SET);
+    if (std::fread(&data[0], 1, data.size(), in) != data.size()) {
+      std::cerr << "read " << path << " failed" << std::endl;
+      std::fclose(in);
+      return 1;
+    }
+    if (p.offset + data.size() < size) {
+      size_t last = data.rfind('\n');
+      if (last == std::string::npos) {
+        std::cerr << "line " << p.lines + 1 << " is longer than " << kChunkBytes << " bytes" << std::endl;
+        std::fclose(in);
+        return 1;
+      }
+      data.resize(last + 1);
+    }
+    if (importChunk(gm, source, data, csv, threads, &p, &skipped) != 0) {
+      std::fclose(in);
+      return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::fprintf(stderr, "imported %llu events, %llu skipped, %.1f/%.1f MB (%.0f%%), %.0f events/s\n",
+                 static_cast<unsigned long long>(p.events), static_cast<unsigned long long>(skipped),
+                 p.offset / 1048576.0, size / 1048576.0, size == 0 ? 100.0 : 100.0 * p.offset / size,
+                 seconds > 0 ? (p.events - importedBefore) / seconds : 0.0);
+  }
+  std::fclose(in);
+  if (gm->FinishImport(source) != 0) {
+    return 1;
+  }
+  std::cout << "import success! " << p.events << " events" << std::endl;
+  return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef GRAPH_IMPORTER_H_
+#define GRAPH_IMPORTER_H_
+
+#include <string>
+
+#include "graph_manager.h"
+
+// Bulk import of events into existing works.
+//
+// Input is NDJSON, one {"gi": 1, "wi": 2, "content": "...", "created_at":
+// "2006-01-02 15:04:05"} per line, or CSV (by .csv extension) with the
+// columns gi,wi,content,created_at and an optional header; created_at
+// defaults to now. The file is processed in chunks: lines are parsed on
+// several threads, and the events of a chunk are written with one
+// WriteBatch (see GraphManager::ImportEvents) that also reserves their ids,
+// adds them to the time and full-text indexes and records how much of the
+// input has been imported. An interrupted import continues after the last
+// written chunk when run again, with the ids that chunk was given.
+int ImportEvents(GraphManager *gm, const std::string &path, int threads);
+
+#endif
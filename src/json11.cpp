@@ -24,7 +24,13 @@
 #include <cmath>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <algorithm>
 #include <limits>
+#include <locale.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
 
 namespace json11 {
 
@@ -46,6 +52,314 @@ struct NullStruct {
     bool operator<(NullStruct) const { return false; }
 };
 
+/* * * * * * * * * * * * * * * * * * * *
+ * Scanning
+ *
+ * The parser and serializer spend most of their time stepping over runs of bytes that
+ * need no work: whitespace between tokens and plain string content. These helpers find
+ * the end of such a run 16 (SSE2) or 32 (AVX2) bytes at a time. The vector width is
+ * picked once at runtime; other targets use the scalar loops.
+ */
+
+// What a string scan stops at: '"', '\\' and control characters, plus the lead byte of
+// U+2028/U+2029 when dumping.
+enum ScanStop { STOP_PARSE, STOP_DUMP };
+
+static inline bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static inline bool is_stop(char c, ScanStop stop) {
+    return c == '"' || c == '\\' || static_cast<uint8_t>(c) < 0x20
+           || (stop == STOP_DUMP && static_cast<uint8_t>(c) == 0xe2);
+}
+
+static size_t scan_space_scalar(const char *s, size_t n) {
+    size_t i = 0;
+    while (i < n && is_space(s[i]))
+        i++;
+    return i;
+}
+
+static size_t scan_plain_scalar(const char *s, size_t n, ScanStop stop) {
+    size_t i = 0;
+    while (i < n && !is_stop(s[i], stop))
+        i++;
+    return i;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define JSON11_X86_SIMD 1
+
+// Each vector loop returns the index of the first byte that ends the run, or the index
+// where fewer than a full vector is left, and the caller finishes with the scalar loop.
+
+static size_t scan_space_sse2(const char *s, size_t n) {
+    const __m128i sp = _mm_set1_epi8(' '), nl = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r'), tab = _mm_set1_epi8('\t');
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, nl)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, tab)));
+        unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(ws)) & 0xffff;
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return i + scan_space_scalar(s + i, n - i);
+}
+
+static size_t scan_plain_sse2(const char *s, size_t n, ScanStop stop) {
+    const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f), e2 = _mm_set1_epi8(static_cast<char>(0xe2));
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        // Unsigned v <= 0x1f is max(v, 0x1f) == 0x1f.
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                   _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+        if (stop == STOP_DUMP)
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, e2));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return i + scan_plain_scalar(s + i, n - i, stop);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_space_avx2(const char *s, size_t n) {
+    const __m256i sp = _mm256_set1_epi8(' '), nl = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r'), tab = _mm256_set1_epi8('\t');
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, nl)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, tab)));
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(ws));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return i + scan_space_sse2(s + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_plain_avx2(const char *s, size_t n, ScanStop stop) {
+    const __m256i quote = _mm256_set1_epi8('"'), backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1f), e2 = _mm256_set1_epi8(static_cast<char>(0xe2));
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                                      _mm256_cmpeq_epi8(v, backslash)),
+                                      _mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control));
+        if (stop == STOP_DUMP)
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, e2));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return i + scan_plain_sse2(s + i, n - i, stop);
+}
+#endif
+
+struct Scanner {
+    size_t (*space)(const char *s, size_t n);
+    size_t (*plain)(const char *s, size_t n, ScanStop stop);
+};
+
+static const Scanner & scanner() {
+    static const Scanner s = []() -> Scanner {
+#ifdef JSON11_X86_SIMD
+        if (__builtin_cpu_supports("avx2"))
+            return Scanner { scan_space_avx2, scan_plain_avx2 };
+        return Scanner { scan_space_sse2, scan_plain_sse2 };
+#else
+        return Scanner { scan_space_scalar, scan_plain_scalar };
+#endif
+    }();
+    return s;
+}
+
+// Returns the length of the run of whitespace at the start of s[0, n).
+static inline size_t scan_space(const char *s, size_t n) {
+    // Most runs between tokens are empty or a single space; skip the call for those.
+    if (n == 0 || !is_space(s[0]))
+        return 0;
+    if (n == 1 || !is_space(s[1]))
+        return 1;
+    return scanner().space(s, n);
+}
+
+// Returns the length of the run of bytes a string scan does not stop at.
+static inline size_t scan_plain(const char *s, size_t n, ScanStop stop) {
+    return scanner().plain(s, n, stop);
+}
+
+static inline bool in_range(long x, long lower, long upper) {
+    return (x >= lower && x <= upper);
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Numbers
+ *
+ * Numbers are converted without the C library where possible, since main() calls
+ * setlocale(LC_ALL, "") and printf/strtod follow LC_NUMERIC: a locale with a decimal
+ * comma would otherwise write invalid JSON and misread "1.5". The rare inputs the fast
+ * paths cannot convert exactly go to the C library under the "C" locale.
+ */
+
+static locale_t c_locale() {
+    static locale_t loc = newlocale(LC_ALL_MASK, "C", static_cast<locale_t>(0));
+    return loc;
+}
+
+// Writes the decimal digits of v to buf, which must hold 20 bytes, and returns their
+// count.
+static size_t format_uint(uint64_t v, char *buf) {
+    char tmp[20];
+    size_t n = 0;
+    do {
+        tmp[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    for (size_t k = 0; k < n; k++)
+        buf[k] = tmp[n - 1 - k];
+    return n;
+}
+
+static void format_int(int64_t v, string &out) {
+    char buf[21];
+    size_t n = 0;
+    uint64_t u = static_cast<uint64_t>(v);
+    if (v < 0) {
+        buf[n++] = '-';
+        u = 0 - u;
+    }
+    n += format_uint(u, buf + n);
+    out.append(buf, n);
+}
+
+// Powers of ten that are exact doubles.
+static const double exact_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/* parse_double(s, end)
+ *
+ * Convert the number in [s, end), which must have passed JsonParser::scan_number or be
+ * printf %g output. Up to 19 significant digits are collected into an integer; when it
+ * and the power of ten are both exact doubles, one multiplication or division gives the
+ * correctly rounded result (Clinger's fast path), which covers nearly all real data.
+ */
+static double parse_double(const char *s, const char *end) {
+    const char *p = s;
+    bool negative = *p == '-';
+    if (negative)
+        p++;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool truncated = false;
+    for (; p < end && in_range(*p, '0', '9'); p++) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+            truncated |= *p != '0';
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && in_range(*p, '0', '9'); p++) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            } else {
+                truncated |= *p != '0';
+            }
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negative_exponent = *p == '-';
+        if (*p == '+' || *p == '-')
+            p++;
+        int e = 0;
+        for (; p < end && in_range(*p, '0', '9'); p++) {
+            if (e < 100000)
+                e = e * 10 + (*p - '0');
+        }
+        exponent += negative_exponent ? -e : e;
+    }
+
+    if (!truncated && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+        double v = static_cast<double>(mantissa);
+        v = exponent < 0 ? v / exact_pow10[-exponent] : v * exact_pow10[exponent];
+        return negative ? -v : v;
+    }
+    return strtod_l(string(s, end).c_str(), nullptr, c_locale());
+}
+
+/* format_double(value, out)
+ *
+ * Append a form of value that reads back exactly and is as short as practical. Integral
+ * values are formatted as integers. Values with few decimals, such as 12.5 or 0.125,
+ * are found by scaling: if value * 10^k is an integer m below 2^53 and m / 10^k gives
+ * value back, then so does parsing the digits of m with a decimal point k places from
+ * the right (see parse_double). Everything else gets the shortest of the %.15g, %.16g
+ * and %.17g forms that reads back as value.
+ */
+static void format_double(double value, string &out) {
+    double a = std::fabs(value);
+    if (value == std::trunc(value) && a < 1e17) {
+        // Through a, so that -0.0 keeps its sign.
+        if (std::signbit(value))
+            out += '-';
+        format_int(static_cast<int64_t>(a), out);
+        return;
+    }
+    if (a >= 1e-4 && a < 1e15) {
+        for (int k = 1; k <= 22; k++) {
+            double scaled = a * exact_pow10[k];
+            if (scaled >= 9007199254740992.0)
+                break;
+            if (scaled != std::trunc(scaled) || scaled / exact_pow10[k] != a)
+                continue;
+            char digits[20];
+            size_t n = format_uint(static_cast<uint64_t>(scaled), digits);
+            while (digits[n - 1] == '0') {
+                n--;
+                k--;
+            }
+            if (value < 0)
+                out += '-';
+            if (static_cast<size_t>(k) >= n) {
+                out += "0.";
+                out.append(k - n, '0');
+                out.append(digits, n);
+            } else {
+                out.append(digits, n - k);
+                out += '.';
+                out.append(digits + n - k, k);
+            }
+            return;
+        }
+    }
+    char buf[32];
+    int n = 0;
+    locale_t old = uselocale(c_locale());
+    for (int precision = 15; precision <= 17; precision++) {
+        n = snprintf(buf, sizeof buf, "%.*g", precision, value);
+        if (precision == 17 || parse_double(buf, buf + n) == value)
+            break;
+    }
+    uselocale(old);
+    out.append(buf, n);
+}
+
 /* * * * * * * * * * * * * * * * * * * *
  * Serialization
  */
@@ -56,18 +370,14 @@ static void dump(NullStruct, string &out) {
 
 static void dump(double value, string &out) {
     if (std::isfinite(value)) {
-        char buf[32];
-        snprintf(buf, sizeof buf, "%.17g", value);
-        out += buf;
+        format_double(value, out);
     } else {
         out += "null";
     }
 }
 
 static void dump(int value, string &out) {
-    char buf[32];
-    snprintf(buf, sizeof buf, "%d", value);
-    out += buf;
+    format_int(value, out);
 }
 
 static void dump(bool value, string &out) {
@@ -77,6 +387,13 @@ static void dump(bool value, string &out) {
 static void dump(const string &value, string &out) {
     out += '"';
     for (size_t i = 0; i < value.length(); i++) {
+        size_t run = scan_plain(value.data() + i, value.length() - i, STOP_DUMP);
+        if (run > 0) {
+            out.append(value, i, run);
+            i += run;
+            if (i == value.length())
+                break;
+        }
         const char ch = value[i];
         if (ch == '\\') {
             out += "\\\\";
@@ -141,6 +458,10 @@ void Json::dump(string &out) const {
     m_ptr->dump(out);
 }
 
+void Json::dump_string(const string &value, string &out) {
+    json11::dump(value, out);
+}
+
 /* * * * * * * * * * * * * * * * * * * *
  * Value wrappers
  */
@@ -335,10 +656,6 @@ static inline string esc(char c) {
     return string(buf);
 }
 
-static inline bool in_range(long x, long lower, long upper) {
-    return (x >= lower && x <= upper);
-}
-
 namespace {
 /* JsonParser
  *
@@ -375,8 +692,8 @@ struct JsonParser final {
      * Advance until the current character is non-whitespace.
      */
     void consume_whitespace() {
-        while (str[i] == ' ' || str[i] == '\r' || str[i] == '\n' || str[i] == '\t')
-            i++;
+        if (i < str.size())
+            i += scan_space(str.data() + i, str.size() - i);
     }
 
     /* consume_comment()
@@ -484,6 +801,16 @@ struct JsonParser final {
             if (i == str.size())
                 return fail("unexpected end of input in string", "");
 
+            // The usual case: a run of non-escaped characters
+            size_t run = scan_plain(str.data() + i, str.size() - i, STOP_PARSE);
+            if (run > 0) {
+                encode_utf8(last_escaped_codepoint, out);
+                last_escaped_codepoint = -1;
+                out.append(str, i, run);
+                i += run;
+                continue;
+            }
+
             char ch = str[i++];
 
             if (ch == '"') {
@@ -494,14 +821,6 @@ struct JsonParser final {
             if (in_range(ch, 0, 0x1f))
                 return fail("unescaped " + esc(ch) + " in string", "");
 
-            // The usual case: non-escaped characters
-            if (ch != '\\') {
-                encode_utf8(last_escaped_codepoint, out);
-                last_escaped_codepoint = -1;
-                out += ch;
-                continue;
-            }
-
             // Handle escapes
             if (i == str.size())
                 return fail("unexpected end of input in string", "");
@@ -566,12 +885,15 @@ struct JsonParser final {
         }
     }
 
-    /* parse_number()
+    /* scan_number(start, is_int)
      *
-     * Parse a double.
+     * Validate the number starting at the current position and advance past it. start is
+     * set to its first character; is_int tells whether it fits an int.
      */
-    Json parse_number() {
+    bool scan_number(size_t &start, bool &is_int) {
         size_t start_pos = i;
+        start = i;
+        is_int = false;
 
         if (str[i] == '-')
             i++;
@@ -580,25 +902,26 @@ struct JsonParser final {
         if (str[i] == '0') {
             i++;
             if (in_range(str[i], '0', '9'))
-                return fail("leading 0s not permitted in numbers");
+                return fail("leading 0s not permitted in numbers", false);
         } else if (in_range(str[i], '1', '9')) {
             i++;
             while (in_range(str[i], '0', '9'))
                 i++;
         } else {
-            return fail("invalid " + esc(str[i]) + " in number");
+            return fail("invalid " + esc(str[i]) + " in number", false);
         }
 
         if (str[i] != '.' && str[i] != 'e' && str[i] != 'E'
                 && (i - start_pos) <= static_cast<size_t>(std::numeric_limits<int>::digits10)) {
-            return std::atoi(str.c_str() + start_pos);
+            is_int = true;
+            return true;
         }
 
         // Decimal part
         if (str[i] == '.') {
             i++;
             if (!in_range(str[i], '0', '9'))
-                return fail("at least one digit required in fractional part");
+                return fail("at least one digit required in fractional part", false);
 
             while (in_range(str[i], '0', '9'))
                 i++;
@@ -612,13 +935,47 @@ struct JsonParser final {
                 i++;
 
             if (!in_range(str[i], '0', '9'))
-                return fail("at least one digit required in exponent");
+                return fail("at least one digit required in exponent", false);
 
             while (in_range(str[i], '0', '9'))
                 i++;
         }
 
-        return std::strtod(str.c_str() + start_pos, nullptr);
+        return true;
+    }
+
+    /* parse_number()
+     *
+     * Parse a double.
+     */
+    Json parse_number() {
+        size_t start_pos;
+        bool is_int;
+        if (!scan_number(start_pos, is_int))
+            return Json();
+        if (is_int)
+            return int_value(start_pos);
+        return parse_double(str.data() + start_pos, str.data() + i);
+    }
+
+    /* int_value(start)
+     *
+     * Convert the number scan_number just found an int at start.
+     */
+    int int_value(size_t start) const {
+        size_t k = start + (str[start] == '-');
+        int v = 0;
+        for (; k < i; k++)
+            v = v * 10 + (str[k] - '0');
+        return str[start] == '-' ? -v : v;
+    }
+
+    /* number_value(start, is_int)
+     *
+     * Convert the number scan_number just found at start.
+     */
+    double number_value(size_t start, bool is_int) const {
+        return is_int ? int_value(start) : parse_double(str.data() + start, str.data() + i);
     }
 
     /* expect(str, res)
@@ -627,13 +984,17 @@ struct JsonParser final {
      * the input and return res. If not, flag an error.
      */
     Json expect(const string &expected, Json res) {
+        return expect_literal(expected) ? res : Json();
+    }
+
+    bool expect_literal(const string &expected) {
         assert(i != 0);
         i--;
         if (str.compare(i, expected.length(), expected) == 0) {
             i += expected.length();
-            return res;
+            return true;
         } else {
-            return fail("parse error: expected " + expected + ", got " + str.substr(i, expected.length()));
+            return fail("parse error: expected " + expected + ", got " + str.substr(i, expected.length()), false);
         }
     }
 
@@ -726,6 +1087,108 @@ struct JsonParser final {
 
         return fail("expected value, got " + esc(ch));
     }
+
+    /* parse_sax(depth, handler)
+     *
+     * Parse a JSON value like parse_json, reporting it to handler instead of building it.
+     */
+    bool parse_sax(int depth, JsonHandler &handler) {
+        if (depth > max_depth) {
+            return fail("exceeded maximum nesting depth", false);
+        }
+
+        char ch = get_next_token();
+        if (failed)
+            return false;
+
+        if (ch == '-' || (ch >= '0' && ch <= '9')) {
+            i--;
+            size_t start_pos;
+            bool is_int;
+            if (!scan_number(start_pos, is_int))
+                return false;
+            return handler.on_number(number_value(start_pos, is_int)) || aborted();
+        }
+
+        if (ch == 't')
+            return expect_literal("true") && (handler.on_bool(true) || aborted());
+
+        if (ch == 'f')
+            return expect_literal("false") && (handler.on_bool(false) || aborted());
+
+        if (ch == 'n')
+            return expect_literal("null") && (handler.on_null() || aborted());
+
+        if (ch == '"') {
+            string value = parse_string();
+            return !failed && (handler.on_string(move(value)) || aborted());
+        }
+
+        if (ch == '{') {
+            if (!handler.on_start_object())
+                return aborted();
+            ch = get_next_token();
+            if (ch == '}')
+                return handler.on_end_object() || aborted();
+
+            while (1) {
+                if (ch != '"')
+                    return fail("expected '\"' in object, got " + esc(ch), false);
+
+                string key = parse_string();
+                if (failed)
+                    return false;
+                if (!handler.on_key(move(key)))
+                    return aborted();
+
+                ch = get_next_token();
+                if (ch != ':')
+                    return fail("expected ':' in object, got " + esc(ch), false);
+
+                if (!parse_sax(depth + 1, handler))
+                    return false;
+
+                ch = get_next_token();
+                if (ch == '}')
+                    break;
+                if (ch != ',')
+                    return fail("expected ',' in object, got " + esc(ch), false);
+
+                ch = get_next_token();
+            }
+            return handler.on_end_object() || aborted();
+        }
+
+        if (ch == '[') {
+            if (!handler.on_start_array())
+                return aborted();
+            ch = get_next_token();
+            if (ch == ']')
+                return handler.on_end_array() || aborted();
+
+            while (1) {
+                i--;
+                if (!parse_sax(depth + 1, handler))
+                    return false;
+
+                ch = get_next_token();
+                if (ch == ']')
+                    break;
+                if (ch != ',')
+                    return fail("expected ',' in list, got " + esc(ch), false);
+
+                ch = get_next_token();
+                (void)ch;
+            }
+            return handler.on_end_array() || aborted();
+        }
+
+        return fail("expected value, got " + esc(ch), false);
+    }
+
+    bool aborted() {
+        return fail("parse aborted by handler", false);
+    }
 };
 }//namespace {
 
@@ -743,6 +1206,21 @@ Json Json::parse(const string &in, string &err, JsonParse strategy) {
     return result;
 }
 
+bool Json::parse_sax(const string &in, JsonHandler &handler, string &err, JsonParse strategy) {
+    JsonParser parser { in, 0, err, false, strategy };
+    if (!parser.parse_sax(0, handler))
+        return false;
+
+    // Check for any trailing garbage
+    parser.consume_garbage();
+    if (parser.failed)
+        return false;
+    if (parser.i != in.size())
+        return parser.fail("unexpected trailing " + esc(in[parser.i]), false);
+
+    return true;
+}
+
 // Documented in json11.hpp
 vector<Json> Json::parse_multi(const string &in,
                                std::string::size_type &parser_stop_pos,
@@ -787,4 +1265,292 @@ bool Json::has_shape(const shape & types, string & err) const {
     return true;
 }
 
+/* * * * * * * * * * * * * * * * * * * *
+ * JsonDocument
+ */
+
+class JsonDocumentBuilder final {
+public:
+    JsonDocumentBuilder(JsonDocument &doc, JsonParser &parser) : doc(doc), p(parser) {}
+
+    /* parse_value(depth)
+     *
+     * Parse a JSON value like JsonParser::parse_json into new nodes and return the index
+     * of its node, or 0 if parsing failed.
+     */
+    uint32_t parse_value(int depth) {
+        if (depth > max_depth)
+            return p.fail("exceeded maximum nesting depth", 0u);
+
+        char ch = p.get_next_token();
+        if (p.failed)
+            return 0;
+
+        if (ch == '-' || (ch >= '0' && ch <= '9')) {
+            p.i--;
+            size_t start_pos;
+            bool is_int;
+            if (!p.scan_number(start_pos, is_int))
+                return 0;
+            uint32_t node = add(Json::NUMBER);
+            doc.m_nodes[node].number = p.number_value(start_pos, is_int);
+            return node;
+        }
+
+        if (ch == 't' || ch == 'f') {
+            if (!p.expect_literal(ch == 't' ? "true" : "false"))
+                return 0;
+            uint32_t node = add(Json::BOOL);
+            doc.m_nodes[node].number = ch == 't' ? 1 : 0;
+            return node;
+        }
+
+        if (ch == 'n')
+            return p.expect_literal("null") ? add(Json::NUL) : 0;
+
+        if (ch == '"')
+            return parse_string();
+
+        if (ch == '{') {
+            uint32_t node = add(Json::OBJECT);
+            size_t mark = stack.size();
+            ch = p.get_next_token();
+            while (ch != '}' || stack.size() > mark) {
+                if (ch != '"')
+                    return p.fail("expected '\"' in object, got " + esc(ch), 0u);
+
+                uint32_t key = parse_string();
+                if (key == 0)
+                    return 0;
+
+                ch = p.get_next_token();
+                if (ch != ':')
+                    return p.fail("expected ':' in object, got " + esc(ch), 0u);
+
+                uint32_t value = parse_value(depth + 1);
+                if (value == 0)
+                    return 0;
+                stack.push_back(std::make_pair(key, value));
+
+                ch = p.get_next_token();
+                if (ch == '}')
+                    break;
+                if (ch != ',')
+                    return p.fail("expected ',' in object, got " + esc(ch), 0u);
+
+                ch = p.get_next_token();
+            }
+            finish_object(node, mark);
+            return node;
+        }
+
+        if (ch == '[') {
+            uint32_t node = add(Json::ARRAY);
+            size_t mark = stack.size();
+            ch = p.get_next_token();
+            while (ch != ']' || stack.size() > mark) {
+                p.i--;
+                uint32_t value = parse_value(depth + 1);
+                if (value == 0)
+                    return 0;
+                stack.push_back(std::make_pair(value, 0u));
+
+                ch = p.get_next_token();
+                if (ch == ']')
+                    break;
+                if (ch != ',')
+                    return p.fail("expected ',' in list, got " + esc(ch), 0u);
+
+                ch = p.get_next_token();
+            }
+            JsonDocument::Node &n = doc.m_nodes[node];
+            n.first = static_cast<uint32_t>(doc.m_items.size());
+            n.size = static_cast<uint32_t>(stack.size() - mark);
+            for (size_t k = mark; k < stack.size(); k++)
+                doc.m_items.push_back(stack[k].first);
+            stack.resize(mark);
+            return node;
+        }
+
+        return p.fail("expected value, got " + esc(ch), 0u);
+    }
+
+private:
+    JsonDocument &doc;
+    JsonParser &p;
+    // Members (key and value) and items (value and 0) of the containers being parsed.
+    vector<std::pair<uint32_t, uint32_t>> stack;
+
+    uint32_t add(Json::Type type) {
+        doc.m_nodes.push_back(JsonDocument::Node{type, false, 0, 0, 0});
+        return static_cast<uint32_t>(doc.m_nodes.size() - 1);
+    }
+
+    /* parse_string()
+     *
+     * Strings without escapes become a slice of the input; the others are decoded by
+     * JsonParser::parse_string into the arena.
+     */
+    uint32_t parse_string() {
+        const string &str = p.str;
+        size_t end = p.i + scan_plain(str.data() + p.i, str.size() - p.i, STOP_PARSE);
+        uint32_t node = add(Json::STRING);
+        if (end < str.size() && str[end] == '"') {
+            doc.m_nodes[node].first = static_cast<uint32_t>(p.i);
+            doc.m_nodes[node].size = static_cast<uint32_t>(end - p.i);
+            p.i = end + 1;
+            return node;
+        }
+        string decoded = p.parse_string();
+        if (p.failed)
+            return 0;
+        JsonDocument::Node &n = doc.m_nodes[node];
+        n.in_arena = true;
+        n.first = static_cast<uint32_t>(doc.m_arena.size());
+        n.size = static_cast<uint32_t>(decoded.size());
+        doc.m_arena.append(decoded);
+        return node;
+    }
+
+    // Sorts the members of an object by key; of duplicate keys the last one wins, as in
+    // Json::parse.
+    void finish_object(uint32_t node, size_t mark) {
+        // Key nodes are created in input order, so they break ties without the buffer
+        // std::stable_sort would allocate.
+        std::sort(stack.begin() + mark, stack.end(),
+                  [this](const std::pair<uint32_t, uint32_t> &a, const std::pair<uint32_t, uint32_t> &b) {
+                      JsonDocument::Str key = doc.str(b.first);
+                      int c = doc.str(a.first).compare(key.data, key.size);
+                      return c < 0 || (c == 0 && a.first < b.first);
+                  });
+        uint32_t first = static_cast<uint32_t>(doc.m_items.size());
+        uint32_t size = 0;
+        for (size_t k = mark; k < stack.size(); k++) {
+            if (k + 1 < stack.size()) {
+                JsonDocument::Str next = doc.str(stack[k + 1].first);
+                if (doc.str(stack[k].first).compare(next.data, next.size) == 0)
+                    continue;
+            }
+            doc.m_items.push_back(stack[k].first);
+            doc.m_items.push_back(stack[k].second);
+            size++;
+        }
+        doc.m_nodes[node].first = first;
+        doc.m_nodes[node].size = size;
+        stack.resize(mark);
+    }
+};
+
+int JsonDocument::Str::compare(const char *s, size_t n) const {
+    int c = std::memcmp(data, s, std::min(size, n));
+    if (c != 0)
+        return c;
+    return size < n ? -1 : (size > n ? 1 : 0);
+}
+
+JsonDocument::Str JsonDocument::str(uint32_t node) const {
+    const Node &n = m_nodes[node];
+    return Str { (n.in_arena ? m_arena.data() : m_input) + n.first, n.size };
+}
+
+bool JsonDocument::parse(const string &in, string &err, JsonParse strategy) {
+    m_input = in.data();
+    m_nodes.clear();
+    m_items.clear();
+    m_arena.clear();
+    m_nodes.push_back(Node{Json::NUL, false, 0, 0, 0});
+    if (in.size() > std::numeric_limits<uint32_t>::max()) {
+        err = "input too large";
+        return false;
+    }
+
+    JsonParser parser { in, 0, err, false, strategy };
+    JsonDocumentBuilder builder(*this, parser);
+    bool ok = builder.parse_value(0) != 0;
+    if (ok) {
+        // Check for any trailing garbage
+        parser.consume_garbage();
+        if (!parser.failed && parser.i != in.size())
+            parser.fail("unexpected trailing " + esc(in[parser.i]), false);
+        ok = !parser.failed;
+    }
+    if (!ok) {
+        m_nodes.resize(1);
+        m_items.clear();
+        m_arena.clear();
+    }
+    return ok;
+}
+
+Json::Type JsonDocument::Value::type() const {
+    return m_doc->m_nodes[m_node].type;
+}
+
+double JsonDocument::Value::number_value() const {
+    return is_number() ? m_doc->m_nodes[m_node].number : 0;
+}
+
+int JsonDocument::Value::int_value() const {
+    return is_number() ? static_cast<int>(m_doc->m_nodes[m_node].number) : 0;
+}
+
+bool JsonDocument::Value::bool_value() const {
+    return is_bool() && m_doc->m_nodes[m_node].number != 0;
+}
+
+JsonDocument::Str JsonDocument::Value::string_value() const {
+    return is_string() ? m_doc->str(m_node) : Str { "", 0 };
+}
+
+size_t JsonDocument::Value::size() const {
+    return is_array() || is_object() ? m_doc->m_nodes[m_node].size : 0;
+}
+
+JsonDocument::Value JsonDocument::Value::operator[](size_t i) const {
+    const Node &n = m_doc->m_nodes[m_node];
+    if (n.type != Json::ARRAY || i >= n.size)
+        return Value(m_doc, 0);
+    return Value(m_doc, m_doc->m_items[n.first + i]);
+}
+
+JsonDocument::Value JsonDocument::Value::operator[](const string &key) const {
+    return find(key.data(), key.size());
+}
+
+JsonDocument::Value JsonDocument::Value::operator[](const char *key) const {
+    return find(key, std::strlen(key));
+}
+
+JsonDocument::Value JsonDocument::Value::find(const char *key, size_t n) const {
+    const Node &node = m_doc->m_nodes[m_node];
+    if (node.type != Json::OBJECT)
+        return Value(m_doc, 0);
+    size_t lo = 0, hi = node.size;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = m_doc->str(m_doc->m_items[node.first + 2 * mid]).compare(key, n);
+        if (c == 0)
+            return Value(m_doc, m_doc->m_items[node.first + 2 * mid + 1]);
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return Value(m_doc, 0);
+}
+
+JsonDocument::Str JsonDocument::Value::key(size_t i) const {
+    const Node &n = m_doc->m_nodes[m_node];
+    if (n.type != Json::OBJECT || i >= n.size)
+        return Str { "", 0 };
+    return m_doc->str(m_doc->m_items[n.first + 2 * i]);
+}
+
+JsonDocument::Value JsonDocument::Value::value(size_t i) const {
+    const Node &n = m_doc->m_nodes[m_node];
+    if (n.type != Json::OBJECT || i >= n.size)
+        return Value(m_doc, 0);
+    return Value(m_doc, m_doc->m_items[n.first + 2 * i + 1]);
+}
+
 } // namespace json11
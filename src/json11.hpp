@@ -50,6 +50,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
@@ -76,6 +77,26 @@ enum JsonParse {
 
 class JsonValue;
 
+/* JsonHandler
+ *
+ * Receives the values of a document from Json::parse_sax in document order, without a
+ * Json tree being built. Every callback returns true to continue or false to abort the
+ * parse. The defaults accept and ignore everything.
+ */
+class JsonHandler {
+public:
+    virtual ~JsonHandler() {}
+    virtual bool on_null() { return true; }
+    virtual bool on_bool(bool) { return true; }
+    virtual bool on_number(double) { return true; }
+    virtual bool on_string(std::string &&) { return true; }
+    virtual bool on_start_object() { return true; }
+    virtual bool on_key(std::string &&) { return true; }
+    virtual bool on_end_object() { return true; }
+    virtual bool on_start_array() { return true; }
+    virtual bool on_end_array() { return true; }
+};
+
 class Json final {
 public:
     // Types
@@ -159,6 +180,8 @@ public:
         dump(out);
         return out;
     }
+    // Serialize a string value, as Json(value).dump(out) would, without building a Json.
+    static void dump_string(const std::string &value, std::string &out);
 
     // Parse. If parse fails, return Json() and assign an error message to err.
     static Json parse(const std::string & in,
@@ -174,6 +197,12 @@ public:
             return nullptr;
         }
     }
+    // Parse with callbacks instead of building a Json. Returns false and assigns err if
+    // the input is malformed or a callback aborted.
+    static bool parse_sax(const std::string & in,
+                          JsonHandler & handler,
+                          std::string & err,
+                          JsonParse strategy = JsonParse::STANDARD);
     // Parse multiple objects, concatenated or separated by whitespace
     static std::vector<Json> parse_multi(
         const std::string & in,
@@ -229,4 +258,95 @@ protected:
     virtual ~JsonValue() {}
 };
 
+/* JsonDocument
+ *
+ * Read-only alternative to Json for parsing large inputs. All values of a document live
+ * in one flat node array, object members are kept sorted by key for binary search, and
+ * strings without escapes are slices of the input, so a parse costs a handful of
+ * allocations instead of one per value, and parsing again into the same document reuses
+ * them. The input must outlive the document.
+ */
+class JsonDocumentBuilder;
+
+class JsonDocument final {
+public:
+    // Characters of a string value, owned by the document or its input.
+    struct Str {
+        const char *data;
+        size_t size;
+
+        std::string str() const { return std::string(data, size); }
+        int compare(const char *s, size_t n) const;
+        bool operator== (const std::string &s) const { return compare(s.data(), s.size()) == 0; }
+        bool operator!= (const std::string &s) const { return !(*this == s); }
+    };
+
+    // A value of the document; values that do not exist read as null.
+    class Value final {
+    public:
+        Json::Type type() const;
+
+        bool is_null()   const { return type() == Json::NUL; }
+        bool is_number() const { return type() == Json::NUMBER; }
+        bool is_bool()   const { return type() == Json::BOOL; }
+        bool is_string() const { return type() == Json::STRING; }
+        bool is_array()  const { return type() == Json::ARRAY; }
+        bool is_object() const { return type() == Json::OBJECT; }
+
+        double number_value() const;
+        int int_value() const;
+        bool bool_value() const;
+        Str string_value() const;
+
+        // Number of array items or object members.
+        size_t size() const;
+        // Array item i.
+        Value operator[](size_t i) const;
+        // Object member by key.
+        Value operator[](const std::string &key) const;
+        Value operator[](const char *key) const;
+        // Object members in key order.
+        Str key(size_t i) const;
+        Value value(size_t i) const;
+
+    private:
+        friend class JsonDocument;
+        Value(const JsonDocument *doc, uint32_t node) : m_doc(doc), m_node(node) {}
+        Value find(const char *key, size_t n) const;
+
+        const JsonDocument *m_doc;
+        uint32_t m_node;
+    };
+
+    // Parse in, replacing the previous document. If parse fails, return false and assign
+    // an error message to err; the document is then empty.
+    bool parse(const std::string &in, std::string &err, JsonParse strategy = JsonParse::STANDARD);
+
+    Value root() const { return Value(this, m_nodes.size() > 1 ? 1 : 0); }
+
+private:
+    friend class JsonDocumentBuilder;
+
+    struct Node {
+        Json::Type type;
+        // Strings: whether data is in m_arena rather than the input.
+        bool in_arena;
+        // Strings: length; arrays and objects: number of items or members.
+        uint32_t size;
+        // Strings: offset of the data; arrays and objects: first entry in m_items.
+        uint32_t first;
+        double number;
+    };
+
+    const char *m_input = nullptr;
+    // m_nodes[0] is the null returned for missing values.
+    std::vector<Node> m_nodes;
+    // Item node indexes of arrays, and key and value node index pairs of objects.
+    std::vector<uint32_t> m_items;
+    // Decoded strings that contained escapes.
+    std::string m_arena;
+
+    Str str(uint32_t node) const;
+};
+
 } // namespace json11
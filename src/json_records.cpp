@@ -0,0 +1,324 @@
+#include <cstdio>
+#include <vector>
+
+#include "fields.h"
+#include "json11.hpp"
+#include "json_records.h"
+#include "util.h"
+
+namespace {
+
+// Containers the handler can be in; kWorks and kRelations are the maps of a
+// legacy graph blob keyed by "work-<id>" and "relation-<id>".
+enum Context {
+    kGraph,
+    kWorks,
+    kWork,
+    kPeople,
+    kEvents,
+    kEvent,
+    kRelations,
+    kRelation,
+};
+
+// Store a parsed string or number into the member of the field it belongs to;
+// values of another type than the field are ignored. The int64_t members are
+// times, which JSON has as strings.
+struct StringSetter {
+    std::string &value;
+
+    void operator()(int, const char *, std::string &v) const { v = std::move(value); }
+
+    void operator()(int, const char *, int64_t &v) const { parseTime(value.c_str(), &v); }
+
+    template <typename T>
+    void operator()(int, const char *, T &) const {}
+};
+
+struct NumberSetter {
+    double value;
+
+    void operator()(int, const char *, int &v) const { v = static_cast<int>(value); }
+
+    void operator()(int, const char *, Status &v) const { v = Status(static_cast<int>(value)); }
+
+    template <typename T>
+    void operator()(int, const char *, T &) const {}
+};
+
+// Fills the struct of the current context from the parse events. Values of
+// unknown fields, including whole objects and arrays, are skipped by
+// counting their nesting depth.
+class RecordHandler : public json11::JsonHandler {
+public:
+    RecordHandler(Context root, Graph *graph, Work *work, Event *event, Relation *relation)
+            : root_(root), graph_(graph), work_(work), event_(event), relation_(relation), skip_(0) {}
+
+    bool on_start_object() override {
+      if (skip_ > 0) {
+        skip_++;
+        return true;
+      }
+      if (stack_.empty()) {
+        stack_.push_back(root_);
+        return true;
+      }
+      Context top = stack_.back();
+      if (top == kGraph && key_ == "works") {
+        stack_.push_back(kWorks);
+      } else if (top == kGraph && key_ == "relations") {
+        stack_.push_back(kRelations);
+      } else if (top == kWorks) {
+        work_ = &graph_->works[key_];
+        *work_ = Work{};
+        stack_.push_back(kWork);
+      } else if (top == kRelations) {
+        relation_ = &graph_->relations[key_];
+        *relation_ = Relation{};
+        stack_.push_back(kRelation);
+      } else if (top == kEvents) {
+        work_->events.push_back(Event{});
+        event_ = &work_->events.back();
+        stack_.push_back(kEvent);
+      } else {
+        skip_ = 1;
+      }
+      return true;
+    }
+
+    bool on_start_array() override {
+      if (skip_ > 0) {
+        skip_++;
+      } else if (stack_.empty()) {
+        return false;
+      } else if (stack_.back() == kWork && key_ == "related_people") {
+        stack_.push_back(kPeople);
+      } else if (stack_.back() == kWork && key_ == "events") {
+        stack_.push_back(kEvents);
+      } else {
+        skip_ = 1;
+      }
+      return true;
+    }
+
+    bool on_end_object() override { return end(); }
+
+    bool on_end_array() override { return end(); }
+
+    bool on_key(std::string &&key) override {
+      if (skip_ == 0) {
+        key_ = std::move(key);
+      }
+      return true;
+    }
+
+    bool on_string(std::string &&value) override {
+      if (skip_ > 0 || stack_.empty()) {
+        return !stack_.empty();
+      }
+      StringSetter set{value};
+      switch (stack_.back()) {
+        case kGraph:
+          VisitGraphField(*graph_, key_, set);
+          break;
+        case kWork:
+          VisitWorkField(*work_, key_, set);
+          break;
+        case kPeople:
+          work_->related_people.push_back(std::move(value));
+          break;
+        case kEvent:
+          VisitEventField(*event_, key_, set);
+          break;
+        case kRelation:
+          VisitRelationField(*relation_, key_, set);
+          break;
+        default:
+          break;
+      }
+      return true;
+    }
+
+    bool on_number(double value) override {
+      if (skip_ > 0 || stack_.empty()) {
+        return !stack_.empty();
+      }
+      NumberSetter set{value};
+      switch (stack_.back()) {
+        case kGraph:
+          VisitGraphField(*graph_, key_, set);
+          break;
+        case kWork:
+          VisitWorkField(*work_, key_, set);
+          break;
+        case kEvent:
+          VisitEventField(*event_, key_, set);
+          break;
+        case kRelation:
+          VisitRelationField(*relation_, key_, set);
+          break;
+        default:
+          break;
+      }
+      return true;
+    }
+
+    bool on_bool(bool) override { return !stack_.empty(); }
+
+    bool on_null() override { return !stack_.empty(); }
+
+private:
+    Context root_;
+    Graph *graph_;
+    Work *work_;
+    Event *event_;
+    Relation *relation_;
+    std::vector<Context> stack_;
+    std::string key_;
+    int skip_;
+
+    bool end() {
+      if (skip_ > 0) {
+        skip_--;
+      } else {
+        stack_.pop_back();
+      }
+      return true;
+    }
+};
+
+bool parse(const std::string &data, RecordHandler *handler, std::string *err) {
+  err->clear();
+  if (!json11::Json::parse_sax(data, *handler, *err)) {
+    if (err->empty()) {
+      *err = "expected a JSON object";
+    }
+    return false;
+  }
+  return true;
+}
+
+// Appends each field as ,"key":value.
+struct FieldWriter {
+    std::string *out;
+
+    void key(const char *k) const {
+      out->append(",\"");
+      out->append(k);
+      out->append("\":");
+    }
+
+    void operator()(int, const char *k, int v) const {
+      char buf[16];
+      key(k);
+      out->append(buf, std::snprintf(buf, sizeof(buf), "%d", v));
+    }
+
+    void operator()(int number, const char *k, Status v) const { (*this)(number, k, static_cast<int>(v)); }
+
+    void operator()(int, const char *k, const std::string &v) const {
+      key(k);
+      json11::Json::dump_string(v, *out);
+    }
+
+    void operator()(int, const char *k, const std::vector<std::string> &v) const {
+      key(k);
+      out->push_back('[');
+      for (size_t i = 0; i < v.size(); i++) {
+        if (i > 0) {
+          out->push_back(',');
+        }
+        json11::Json::dump_string(v[i], *out);
+      }
+      out->push_back(']');
+    }
+
+    void operator()(int, const char *k, int64_t v) const {
+      char buf[64];
+      int n = formatTime(buf, sizeof(buf), v);
+      key(k);
+      out->push_back('"');
+      out->append(buf, n);
+      out->push_back('"');
+    }
+};
+
+// Appends r as an object that the caller adds members to and closes: the comma
+// before the first field becomes the opening brace.
+template <typename R>
+void appendObject(const R &r, void (*append)(const R &, std::string *), std::string *out) {
+  size_t open = out->size();
+  append(r, out);
+  (*out)[open] = '{';
+}
+
+}  // namespace
+
+bool ParseGraphJson(const std::string &data, Graph *graph, std::string *err) {
+  RecordHandler handler(kGraph, graph, nullptr, nullptr, nullptr);
+  return parse(data, &handler, err);
+}
+
+bool ParseWorkJson(const std::string &data, Work *work, std::string *err) {
+  RecordHandler handler(kWork, nullptr, work, nullptr, nullptr);
+  return parse(data, &handler, err);
+}
+
+bool ParseEventJson(const std::string &data, Event *event, std::string *err) {
+  RecordHandler handler(kEvent, nullptr, nullptr, event, nullptr);
+  return parse(data, &handler, err);
+}
+
+bool ParseRelationJson(const std::string &data, Relation *relation, std::string *err) {
+  RecordHandler handler(kRelation, nullptr, nullptr, nullptr, relation);
+  return parse(data, &handler, err);
+}
+
+void AppendGraphFields(const Graph &graph, std::string *out) {
+  ForEachGraphField(graph, FieldWriter{out});
+}
+
+void AppendWorkFields(const Work &work, std::string *out) {
+  ForEachWorkField(work, FieldWriter{out});
+}
+
+void AppendEventFields(const Event &event, std::string *out) {
+  ForEachEventField(event, FieldWriter{out});
+}
+
+void AppendRelationFields(const Relation &relation, std::string *out) {
+  ForEachRelationField(relation, FieldWriter{out});
+}
+
+void DumpGraphJson(const Graph &graph, std::string *out) {
+  appendObject(graph, AppendGraphFields, out);
+  out->append(",\"works\":{");
+  for (auto it = graph.works.begin(); it != graph.works.end(); it++) {
+    if (it != graph.works.begin()) {
+      out->push_back(',');
+    }
+    json11::Json::dump_string(it->first, *out);
+    out->push_back(':');
+    appendObject(it->second, AppendWorkFields, out);
+    out->append(",\"events\":[");
+    for (size_t i = 0; i < it->second.events.size(); i++) {
+      if (i > 0) {
+        out->push_back(',');
+      }
+      appendObject(it->second.events[i], AppendEventFields, out);
+      out->push_back('}');
+    }
+    out->append("]}");
+  }
+  out->append("},\"relations\":{");
+  for (auto it = graph.relations.begin(); it != graph.relations.end(); it++) {
+    if (it != graph.relations.begin()) {
+      out->push_back(',');
+    }
+    json11::Json::dump_string(it->first, *out);
+    out->push_back(':');
+    appendObject(it->second, AppendRelationFields, out);
+    out->push_back('}');
+  }
+  out->append("}}");
+}
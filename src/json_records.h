@@ -0,0 +1,41 @@
+#ifndef GRAPH_JSON_RECORDS_H_
+#define GRAPH_JSON_RECORDS_H_
+
+#include <string>
+
+#include "graph.h"
+
+// JSON encoding of the records, generated from their field descriptors (see
+// fields.h).
+//
+// The decoders read the JSON records of older storage layouts. They are driven
+// by json11::Json::parse_sax and fill the structs as the document is read, so
+// no Json tree is built. Unknown fields are skipped and missing ones keep the
+// value already in the struct.
+
+// Parses a graph header, or a legacy graph blob including its works (with
+// events) and relations.
+bool ParseGraphJson(const std::string &data, Graph *graph, std::string *err);
+
+// Parses a work and, in legacy blobs, its events.
+bool ParseWorkJson(const std::string &data, Work *work, std::string *err);
+
+bool ParseEventJson(const std::string &data, Event *event, std::string *err);
+
+bool ParseRelationJson(const std::string &data, Relation *relation, std::string *err);
+
+// Append the fields of a record to out as ,"key":value pairs, for callers that
+// open the object themselves. Times are written as "2006-01-02 15:04:05".
+void AppendGraphFields(const Graph &graph, std::string *out);
+
+void AppendWorkFields(const Work &work, std::string *out);
+
+void AppendEventFields(const Event &event, std::string *out);
+
+void AppendRelationFields(const Relation &relation, std::string *out);
+
+// Serializes a graph with its works, events and relations in the blob layout
+// ParseGraphJson reads.
+void DumpGraphJson(const Graph &graph, std::string *out);
+
+#endif
@@ -0,0 +1,375 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "keys.h"
+
+const std::string kGraphPrefix = "graph-";
+const std::string kWorkPrefix = "work-";
+const std::string kEventPrefix = "event-";
+const std::string kRelationPrefix = "relation-";
+const std::string kEventTimePrefix = "tidx-";
+const std::string kWorkIndexPrefix = "widx-";
+const std::string kEventCountPrefix = "ecnt-";
+const std::string kFtsPrefix = "fts-";
+const std::string kCheckpointPrefix = "ckpt-";
+const std::string kCowPrefix = "cow-";
+const std::string kCowCheckpointPrefix = "cowc-";
+const std::string kSeqPrefix = "seq-";
+const std::string kMetaLayout = "meta-layout";
+const std::string kLayoutVersion = "8";
+
+static const int kIdWidth = 10;
+static const int kTimeWidth = 20;
+
+static void appendId(std::string *key, int id) {
+  char buf[16];
+  int n = std::snprintf(buf, sizeof(buf), "%010d", id);
+  key->append(buf, n);
+}
+
+static bool parseId(const char *p, int *id) {
+  int v = 0;
+  for (int i = 0; i < kIdWidth; i++) {
+    if (p[i] < '0' || p[i] > '9') {
+      return false;
+    }
+    v = v * 10 + (p[i] - '0');
+  }
+  *id = v;
+  return true;
+}
+
+static void appendTime(std::string *key, int64_t t) {
+  char buf[24];
+  int n = std::snprintf(buf, sizeof(buf), "%020lld", static_cast<long long>(t < 0 ? 0 : t));
+  key->append(buf, n);
+}
+
+std::string GraphKey(int gi) {
+  std::string key = kGraphPrefix;
+  appendId(&key, gi);
+  return key;
+}
+
+std::string WorkPrefix(int gi) {
+  std::string key = kWorkPrefix;
+  appendId(&key, gi);
+  key.push_back('-');
+  return key;
+}
+
+std::string WorkKey(int gi, int wi) {
+  std::string key = WorkPrefix(gi);
+  appendId(&key, wi);
+  return key;
+}
+
+std::string EventPrefix(int gi) {
+  std::string key = kEventPrefix;
+  appendId(&key, gi);
+  key.push_back('-');
+  return key;
+}
+
+std::string EventPrefix(int gi, int wi) {
+  std::string key = EventPrefix(gi);
+  appendId(&key, wi);
+  key.push_back('-');
+  return key;
+}
+
+std::string EventKey(int gi, int wi, int ei) {
+  std::string key = EventPrefix(gi, wi);
+  appendId(&key, ei);
+  return key;
+}
+
+std::string RelationPrefix(int gi) {
+  std::string key = kRelationPrefix;
+  appendId(&key, gi);
+  key.push_back('-');
+  return key;
+}
+
+std::string RelationKey(int gi, int ri) {
+  std::string key = RelationPrefix(gi);
+  appendId(&key, ri);
+  return key;
+}
+
+std::string EventTimePrefix(int gi) {
+  std::string key = kEventTimePrefix;
+  appendId(&key, gi);
+  key.push_back('-');
+  return key;
+}
+
+std::string EventTimeSeekKey(int gi, int64_t createdAt) {
+  std::string key = EventTimePrefix(gi);
+  appendTime(&key, createdAt);
+  return key;
+}
+
+std::string EventTimeKey(int gi, int64_t createdAt, int wi, int ei) {
+  std::string key = EventTimeSeekKey(gi, createdAt);
+  key.push_back('-');
+  appendId(&key, wi);
+  key.push_back('-');
+  appendId(&key, ei);
+  return key;
+}
+
+bool ParseEventTimeKey(const leveldb::Slice &key, int *gi, int64_t *createdAt, int *wi, int *ei) {
+  const size_t n = kEventTimePrefix.size();
+  if (key.size() != n + 3 * kIdWidth + kTimeWidth + 3 || !key.starts_with(kEventTimePrefix)) {
+    return false;
+  }
+  const char *p = key.data() + n;
+  if (!parseId(p, gi)) {
+    return false;
+  }
+  p += kIdWidth + 1;
+  int64_t t = 0;
+  for (int i = 0; i < kTimeWidth; i++) {
+    if (p[i] < '0' || p[i] > '9') {
+      return false;
+    }
+    t = t * 10 + (p[i] - '0');
+  }
+  *createdAt = t;
+  p += kTimeWidth + 1;
+  return parseId(p, wi) && parseId(p + kIdWidth + 1, ei);
+}
+
+std::string EventCountPrefix(int gi) {
+  std::string key = kEventCountPrefix;
+  appendId(&key, gi);
+  key.push_back('-');
+  return key;
+}
+
+std::string EventCountKey(int gi, int wi) {
+  std::string key = EventCountPrefix(gi);
+  appendId(&key, wi);
+  return key;
+}
+
+std::string WorkIndexPrefix(int gi) {
+  std::string key = kWorkIndexPrefix;
+  appendId(&key, gi);
+  key.push_back('-');
+  return key;
+}
+
+std::string WorkStatusPrefix(int gi, int status) {
+  std::string key = WorkIndexPrefix(gi) + "s-";
+  appendId(&key, status);
+  key.push_back('-');
+  return key;
+}
+
+std::string WorkStatusKey(int gi, int status, int wi) {
+  std::string key = WorkStatusPrefix(gi, status);
+  appendId(&key, wi);
+  return key;
+}
+
+std::string WorkPriorityPrefix(int gi) {
+  return WorkIndexPrefix(gi) + "p-";
+}
+
+// Flipping the sign bit makes negative priorities sort before positive ones.
+static void appendPriority(std::string *key, int priority) {
+  char buf[16];
+  int n = std::snprintf(buf, sizeof(buf), "%010u", static_cast<unsigned>(priority) ^ 0x80000000u);
+  key->append(buf, n);
+}
+
+std::string WorkPrioritySeekKey(int gi, int minPriority) {
+  std::string key = WorkPriorityPrefix(gi);
+  appendPriority(&key, minPriority);
+  return key;
+}
+
+std::string WorkPriorityKey(int gi, int priority, int wi) {
+  std::string key = WorkPrioritySeekKey(gi, priority);
+  key.push_back('-');
+  appendId(&key, wi);
+  return key;
+}
+
+// Person names are terminated by '\0' so that "al" never matches "alice".
+std::string WorkPersonPrefix(int gi, const std::string &person) {
+  std::string key = WorkIndexPrefix(gi) + "u-";
+  key.append(person);
+  key.push_back('\0');
+  return key;
+}
+
+std::string WorkPersonKey(int gi, const std::string &person, int wi) {
+  std::string key = WorkPersonPrefix(gi, person);
+  appendId(&key, wi);
+  return key;
+}
+
+std::string FtsPrefix(int gi) {
+  std::string key = kFtsPrefix;
+  appendId(&key, gi);
+  key.push_back('-');
+  return key;
+}
+
+std::string FtsTermPrefix(int gi, const std::string &term) {
+  std::string key = FtsPrefix(gi);
+  key.append(term);
+  key.push_back('\0');
+  return key;
+}
+
+std::string FtsSegmentKey(int gi, const std::string &term, uint64_t first) {
+  std::string key = FtsTermPrefix(gi, term);
+  char buf[20];
+  int n = std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(first));
+  key.append(buf, n);
+  return key;
+}
+
+uint64_t ParseFtsSegmentKey(const leveldb::Slice &key) {
+  if (key.size() < 16) {
+    return 0;
+  }
+  return std::strtoull(std::string(key.data() + key.size() - 16, 16).c_str(), nullptr, 16);
+}
+
+std::string FtsDocCountKey(int gi) {
+  std::string key = "ftsn-";
+  appendId(&key, gi);
+  return key;
+}
+
+std::string ImportKey(const std::string &source) {
+  return "meta-import-" + source;
+}
+
+std::string ImportProgressKey(const std::string &source) {
+  return "meta-import-progress-" + source;
+}
+
+std::string CheckpointPrefix(int gi) {
+  std::string key = kCheckpointPrefix;
+  appendId(&key, gi);
+  key.push_back('-');
+  return key;
+}
+
+std::string CheckpointKey(int gi, int ci) {
+  std::string key = CheckpointPrefix(gi);
+  appendId(&key, ci);
+  return key;
+}
+
+std::string CowPrefix(int gi) {
+  std::string key = kCowPrefix;
+  appendId(&key, gi);
+  key.push_back('-');
+  return key;
+}
+
+std::string CowKey(int gi, const std::string &key, int ci) {
+  std::string k = CowPrefix(gi);
+  k.append(key);
+  k.push_back('\0');
+  appendId(&k, ci);
+  return k;
+}
+
+bool ParseCowKey(const leveldb::Slice &key, std::string *versioned, int *ci) {
+  const size_t n = kCowPrefix.size() + kIdWidth + 1;
+  if (key.size() < n + kIdWidth + 1 || !key.starts_with(kCowPrefix) || key[key.size() - kIdWidth - 1] != '\0') {
+    return false;
+  }
+  versioned->assign(key.data() + n, key.size() - n - kIdWidth - 1);
+  return parseId(key.data() + key.size() - kIdWidth, ci);
+}
+
+std::string CowCheckpointPrefix(int gi) {
+  std::string key = kCowCheckpointPrefix;
+  appendId(&key, gi);
+  key.push_back('-');
+  return key;
+}
+
+std::string CowCheckpointPrefix(int gi, int ci) {
+  std::string key = CowCheckpointPrefix(gi);
+  appendId(&key, ci);
+  key.push_back('-');
+  return key;
+}
+
+std::string CowCheckpointKey(int gi, int ci, const std::string &key) {
+  return CowCheckpointPrefix(gi, ci) + key;
+}
+
+bool ParseRecordGraph(const leveldb::Slice &key, int *gi) {
+  const std::string *prefixes[] = {&kGraphPrefix, &kWorkPrefix, &kEventPrefix, &kRelationPrefix};
+  for (auto prefix: prefixes) {
+    if (key.starts_with(*prefix)) {
+      size_t n = prefix->size();
+      if (key.size() < n + kIdWidth || !parseId(key.data() + n, gi)) {
+        return false;
+      }
+      return prefix != &kGraphPrefix || key.size() == n + kIdWidth;
+    }
+  }
+  return false;
+}
+
+std::string GraphSeqKey() {
+  return kSeqPrefix + "graph";
+}
+
+std::string WorkSeqKey(int gi) {
+  return kSeqPrefix + WorkPrefix(gi);
+}
+
+std::string EventSeqKey(int gi, int wi) {
+  return kSeqPrefix + EventPrefix(gi, wi);
+}
+
+std::string CheckpointSeqKey(int gi) {
+  return kSeqPrefix + CheckpointPrefix(gi);
+}
+
+int ParseTrailingId(const leveldb::Slice &key) {
+  int id = 0;
+  if (key.size() < static_cast<size_t>(kIdWidth) || !parseId(key.data() + key.size() - kIdWidth, &id)) {
+    return 0;
+  }
+  return id;
+}
+
+bool ParseWorkKey(const leveldb::Slice &key, int *gi, int *wi) {
+  const size_t n = kWorkPrefix.size();
+  if (key.size() != n + 2 * kIdWidth + 1 || !key.starts_with(kWorkPrefix)) {
+    return false;
+  }
+  const char *p = key.data() + n;
+  return parseId(p, gi) && parseId(p + kIdWidth + 1, wi);
+}
+
+bool ParseEventKey(const leveldb::Slice &key, int *gi, int *wi, int *ei) {
+  const size_t n = kEventPrefix.size();
+  if (key.size() != n + 3 * kIdWidth + 2 || !key.starts_with(kEventPrefix)) {
+    return false;
+  }
+  const char *p = key.data() + n;
+  return parseId(p, gi) && parseId(p + kIdWidth + 1, wi) && parseId(p + 2 * (kIdWidth + 1), ei);
+}
+
+bool IsLegacyGraphKey(const leveldb::Slice &key) {
+  if (!key.starts_with(kGraphPrefix)) {
+    return false;
+  }
+  int gi;
+  return key.size() != kGraphPrefix.size() + kIdWidth || !parseId(key.data() + kGraphPrefix.size(), &gi);
+}
@@ -0,0 +1,164 @@
+#ifndef GRAPH_KEYS_H_
+#define GRAPH_KEYS_H_
+
+#include <stdint.h>
+#include <string>
+
+#include "leveldb/slice.h"
+
+// Storage layout: every entity lives under its own key so that mutating one
+// work or event only rewrites that record. Ids are zero padded so that keys of
+// the same kind sort numerically and a trailing '-' bounds prefix scans.
+//
+//   graph-<gi>                  graph header (id, name)
+//   work-<gi>-<wi>              work without its events
+//   event-<gi>-<wi>-<ei>        event
+//   relation-<gi>-<ri>          relation
+//   tidx-<gi>-<us>-<wi>-<ei>    empty; events ordered by creation time
+//   ecnt-<gi>-<wi>              number of events of a work
+//   widx-<gi>-s-<status>-<wi>   empty; works by status
+//   widx-<gi>-p-<priority>-<wi> empty; works by priority (sign-flipped)
+//   widx-<gi>-u-<person>\0<wi>  empty; works by related person
+//   fts-<gi>-<term>\0<doc>      full-text posting segment, see fts.h
+//   ftsn-<gi>                   number of indexed documents of a graph
+//   ckpt-<gi>-<ci>              checkpoint header (id, creation time)
+//   cow-<gi>-<key>\0<ci>        value of a graph, work, event or relation
+//                               key as of checkpoint ci, see graph_manager.h
+//   cowc-<gi>-<ci>-<key>        empty; the keys saved under checkpoint ci
+//   meta-layout                 storage layout version
+//   meta-import-<source>        empty; bulk import of source completed
+//   meta-import-progress-<source>
+//                               input consumed by an unfinished import
+//   seq-graph                   last allocated graph id
+//   seq-work-<gi>-              last allocated work id of a graph
+//   seq-event-<gi>-<wi>-        last allocated event id of a work
+//   seq-ckpt-<gi>-              last allocated checkpoint id of a graph
+extern const std::string kGraphPrefix;
+extern const std::string kWorkPrefix;
+extern const std::string kEventPrefix;
+extern const std::string kRelationPrefix;
+extern const std::string kEventTimePrefix;
+extern const std::string kWorkIndexPrefix;
+extern const std::string kEventCountPrefix;
+extern const std::string kFtsPrefix;
+extern const std::string kCheckpointPrefix;
+extern const std::string kCowPrefix;
+extern const std::string kCowCheckpointPrefix;
+extern const std::string kSeqPrefix;
+extern const std::string kMetaLayout;
+extern const std::string kLayoutVersion;
+
+std::string GraphKey(int gi);
+
+std::string WorkKey(int gi, int wi);
+
+std::string WorkPrefix(int gi);
+
+std::string EventKey(int gi, int wi, int ei);
+
+std::string EventPrefix(int gi, int wi);
+
+std::string EventPrefix(int gi);
+
+std::string RelationKey(int gi, int ri);
+
+std::string RelationPrefix(int gi);
+
+// Time index keys carry created_at as 20 digit epoch microseconds.
+std::string EventTimeKey(int gi, int64_t createdAt, int wi, int ei);
+
+std::string EventTimePrefix(int gi);
+
+// Returns the first possible time index key of gi at or after createdAt.
+std::string EventTimeSeekKey(int gi, int64_t createdAt);
+
+bool ParseEventTimeKey(const leveldb::Slice &key, int *gi, int64_t *createdAt, int *wi, int *ei);
+
+std::string EventCountKey(int gi, int wi);
+
+std::string EventCountPrefix(int gi);
+
+std::string WorkIndexPrefix(int gi);
+
+std::string WorkStatusKey(int gi, int status, int wi);
+
+std::string WorkStatusPrefix(int gi, int status);
+
+std::string WorkPriorityKey(int gi, int priority, int wi);
+
+std::string WorkPriorityPrefix(int gi);
+
+// Returns the first priority index key of gi with priority >= minPriority.
+std::string WorkPrioritySeekKey(int gi, int minPriority);
+
+std::string WorkPersonKey(int gi, const std::string &person, int wi);
+
+std::string WorkPersonPrefix(int gi, const std::string &person);
+
+std::string FtsPrefix(int gi);
+
+std::string FtsTermPrefix(int gi, const std::string &term);
+
+std::string FtsSegmentKey(int gi, const std::string &term, uint64_t first);
+
+// Returns the first document encoded at the end of a posting segment key.
+uint64_t ParseFtsSegmentKey(const leveldb::Slice &key);
+
+std::string FtsDocCountKey(int gi);
+
+// ImportKey marks a finished import of source; ImportProgressKey holds the
+// progress of an unfinished one.
+std::string ImportKey(const std::string &source);
+
+std::string ImportProgressKey(const std::string &source);
+
+std::string CheckpointKey(int gi, int ci);
+
+std::string CheckpointPrefix(int gi);
+
+// Values under cow keys start with one of these markers telling whether the
+// key existed; kCowPresent is followed by the value.
+const char kCowAbsent = 0;
+const char kCowPresent = 1;
+
+std::string CowKey(int gi, const std::string &key, int ci);
+
+std::string CowPrefix(int gi);
+
+// Splits a cow key into the versioned key and its checkpoint id.
+bool ParseCowKey(const leveldb::Slice &key, std::string *versioned, int *ci);
+
+// Cow checkpoint keys list the cow keys of one checkpoint, so that deleting
+// it does not scan the saved values of the other checkpoints.
+std::string CowCheckpointKey(int gi, int ci, const std::string &key);
+
+std::string CowCheckpointPrefix(int gi, int ci);
+
+std::string CowCheckpointPrefix(int gi);
+
+// Returns the graph of a graph, work, event or relation key; returns false
+// for every other key, including legacy graph blobs.
+bool ParseRecordGraph(const leveldb::Slice &key, int *gi);
+
+std::string GraphSeqKey();
+
+std::string WorkSeqKey(int gi);
+
+std::string EventSeqKey(int gi, int wi);
+
+std::string CheckpointSeqKey(int gi);
+
+// Returns the id encoded at the end of a graph, work, event or relation key.
+int ParseTrailingId(const leveldb::Slice &key);
+
+// Parses the ids encoded in a work key; returns false if key is not one.
+bool ParseWorkKey(const leveldb::Slice &key, int *gi, int *wi);
+
+// Parses the ids encoded in an event key; returns false if key is not one.
+bool ParseEventKey(const leveldb::Slice &key, int *gi, int *wi, int *ei);
+
+// Returns true if key belongs to the legacy layout where a whole graph was a
+// single JSON blob stored under "graph-<gi>" without padding.
+bool IsLegacyGraphKey(const leveldb::Slice &key);
+
+#endif
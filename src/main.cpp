@@ -4,16 +4,26 @@
 #include <map>
 #include <sstream>
 #include <cstdio>
+#include <cstdlib>
 #include <locale.h>
 #include <algorithm>
 #include <unistd.h>
+#include <fstream>
+#include <limits.h>
 
 #include "leveldb/db.h"
 #include "leveldb/options.h"
 #include "leveldb/env.h"
 #include "graph.h"
-#include "json11.hpp"
+#include "batch.h"
+#include "buffered_writer.h"
+#include "daemon.h"
+#include "exporter.h"
+#include "graph_manager.h"
+#include "importer.h"
+#include "keys.h"
 #include "gflags/gflags.h"
+#include "table.h"
 #include "util.h"
 
 
@@ -21,330 +31,137 @@ DEFINE_string(gn, "", "graph name");
 DEFINE_int32(gi, 0, "graph id");
 DEFINE_string(wc, "", "work content");
 DEFINE_int32(wi, 0, "work id");
-DEFINE_string(wrp, "", "comma separated work related people");
-DEFINE_int32(ws, 0, "work status");
-DEFINE_int32(wp, 0, "work priority");
+DEFINE_string(wrp, "", "comma separated work related people, or the person to filter li w by");
+DEFINE_int32(ws, 0, "work status, filters li w when set");
+DEFINE_int32(wp, 0, "work priority, li w lists works with at least this priority when set");
 DEFINE_string(ec, "", "event content");
 DEFINE_int32(ei, 0, "event id");
+DEFINE_int32(ci, 0, "checkpoint id; li w and li e read the graph as of it when set");
 DEFINE_int32(of, -1, "offset days from now");
+DEFINE_string(q, "", "full-text search query");
+DEFINE_int32(limit, 20, "maximum number of search results");
+DEFINE_int32(page, 0, "page size of li, 0 lists everything");
+DEFINE_string(after, "", "continue li after this cursor, as printed at the end of the previous page");
+DEFINE_string(format, "table", "output format of li: table, ndjson, csv or tsv");
+DEFINE_int32(threads, 0, "import parser threads, 0 for one per core");
 // This is a declaration/definition.
 // Global namespace can only have declaration/definition, can't have expressions eg: x=3.
 // Because TU(translation unit) executed order is not defined.
 DEFINE_string(dd, "", "data storage dir");
+DEFINE_bool(daemon, false, "keep the db open and serve commands over a unix socket");
+DEFINE_string(sock, "", "daemon socket path, defaults to <dd>/graph.sock");
 
 const std::string kCreate = "ad";
 const std::string kList = "li";
 const std::string kDelete = "de";
 const std::string kUpdate = "up";
+const std::string kSearch = "se";
+const std::string kBatch = "ba";
+const std::string kImport = "im";
+const std::string kExport = "ex";
+const std::string kRestore = "rs";
 
 const std::string kGraph = "g";
 const std::string kWork = "w";
 
 const std::string kEvent = "e";
 const std::string kRelation = "r";
+const std::string kCheckpoint = "c";
 
-const std::string kSeparator = "-";
-
-int SperatorWidth = getStrWidth(kSeparator.c_str());
-
-class GraphManager {
-public:
-    GraphManager(leveldb::DB *db) : db_(db) {};
-
-    ~GraphManager() { delete db_; }
-
-    int ListGraph(std::vector<Graph *> *graphs);
-
-    int DeleteGraph(int id);
-
-    int GetGraph(Graph *graph, int gi);
-
-    int SaveGraph(Graph *graph);
-
-    int GenerateGraphCheckpoint(int id);
-
-    int ListGraphCheckpoint(int id);
-
-    int DeleteGraphCheckpoint(int graphID, int checkPointID);
-
-    std::string DumpGraph(Graph *graph);
-
-
-private:
-    leveldb::DB *db_;
-
-    void parseRelations(json11::Json obj, std::map<std::string, Relation> &relations);
-
-    void parseRelation(json11::Json obj, Relation *relation);
-
-    void parseEvents(json11::Json obj, std::vector<Event> *events);
-
-    void parseEvent(json11::Json obj, Event *event);
-
-    void parseWorks(json11::Json obj, std::map<std::string, Work> &works);
-
-    void parseWork(json11::Json obj, Work *work);
-
-    void parseGraph(std::map<std::string, json11::Json> obj, Graph *graph);
-};
-
-
-const std::string kGraphPrefix = "graph-";
-const std::string kWorkPrefix = "work-";
-const std::string kRelationPrefix = "relation-";
-
-
-void GraphManager::parseGraph(std::map<std::string, json11::Json> items, Graph *graph) {
-  auto item = items.find("id");
-  if (item != items.end()) {
-    graph->id = item->second.int_value();
-  }
-
-  item = items.find("name");
-  if (item != items.end()) {
-    graph->name = item->second.string_value();
-  }
-
-  if (items.find("relations") != items.end()) {
-    parseRelations(items["relations"], graph->relations);
-  }
-
-  if (items.find("works") != items.end()) {
-    parseWorks(items["works"], graph->works);
-  }
+// Tables write to the stdout descriptor directly, after what stdio holds.
+void flushStdio() {
+  std::cout.flush();
+  std::fflush(stdout);
 }
 
-void GraphManager::parseRelations(json11::Json obj, std::map<std::string, Relation> &relations) {
-  auto items = obj.object_items();
-  for (auto it = items.begin(); it != items.end(); it++) {
-    Relation relation;
-    parseRelation(it->second, &relation);
-    relations[it->first] = relation;
-  }
-}
+// Returned by the row callbacks of a scan to stop it at the end of a page.
+const int kPageFull = 1;
 
-void GraphManager::parseRelation(json11::Json obj, Relation *relation) {
-  auto items = obj.object_items();
-  relation->id = items.find("id")->second.int_value();
-  relation->w1 = items.find("w1")->second.int_value();
-  relation->w2 = items.find("w2")->second.int_value();
-  relation->description = items.find("description")->second.string_value();
-}
-
-void GraphManager::parseWorks(json11::Json obj, std::map<std::string, Work> &works) {
-  auto items = obj.object_items();
-  for (auto it = items.begin(); it != items.end(); it++) {
-    Work work;
-    parseWork(it->second, &work);
-    works[it->first] = work;
-  }
-}
-
-void GraphManager::parseWork(json11::Json obj, Work *work) {
-  auto items = obj.object_items();
-  work->id = items.find("id")->second.int_value();
-  work->content = items.find("content")->second.string_value();
-  auto peopleItems = items.find("related_people");
-  if (peopleItems != items.end()) {
-    for (auto it = peopleItems->second.array_items().begin(); it != peopleItems->second.array_items().end(); it++) {
-      work->related_people.push_back(it->string_value());
-    }
-  }
-
-  work->status = Status(items.find("status")->second.int_value());
-  work->priority = Status(items.find("priority")->second.int_value());
-
-  auto es = items.find("events");
-  if (es != items.end()) {
-    for (auto it = es->second.array_items().begin(); it != es->second.array_items().end(); it++) {
-      Event et;
-      auto items = it->object_items();
-      et.id = items.find("id")->second.int_value();
-      et.content = items.find("content")->second.string_value();
-      strptime(items.find("created_at")->second.string_value().c_str(), "%Y-%m-%d %H:%M:%S", &(et.createdAt));
-      work->events.push_back(et);
-    }
-  }
-  strptime(items.find("updated_at")->second.string_value().c_str(), "%Y-%m-%d %H:%M:%S", &(work->updatedAt));
-}
-
-int GraphManager::ListGraph(std::vector<Graph *> *graphs) {
-  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
-  iterator->Seek(kGraphPrefix);
-  while (iterator->Valid()) {
-    json11::Json json = json11::Json();
-    std::string err;
-    json = json.parse(iterator->value().ToString(), err);
-    Graph *graph = new Graph;
-    parseGraph(json.object_items(), graph);
-    graphs->push_back(graph);
-    iterator->Next();
-  }
-  delete iterator;
-}
+// Counts the rows of a listing. With a limit, the row after the last one that
+// fits ends the page and shows that the listing continues; End then prints the
+// --after cursor of the last row for the next page.
+class Page {
+public:
+    explicit Page(int limit) : limit_(limit), rows_(0), more_(false) {}
 
-std::string GraphManager::DumpGraph(Graph *graph) {
-  json11::Json::object g{
-          {"id",   graph->id},
-          {"name", graph->name}};
-  json11::Json::object works;
-  if (!graph->works.empty()) {
-    for (auto &it: graph->works) {
-      json11::Json::object work{
-              {"id",       it.second.id},
-              {"content",  it.second.content},
-              {"status",   it.second.status},
-              {"priority", it.second.priority},
-      };
-      char buf[255];
-      strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &it.second.updatedAt);
-      work["updated_at"] = std::string(buf);
-      json11::Json::array related_people;
-      for (auto &it1: it.second.related_people) {
-        related_people.push_back(it1);
-      }
-      work["related_people"] = related_people;
-      json11::Json::array events;
-      for (auto &it1: it.second.events) {
-        json11::Json::object event{
-                {"id",      it1.id},
-                {"content", it1.content}};
-        char buf[255];
-        formatTime(buf, 255, &it1.createdAt);
-        event["created_at"] = std::string(buf);
-        events.push_back(event);
+    // Returns false if the page is already full.
+    bool Add() {
+      if (limit_ > 0 && rows_ == limit_) {
+        more_ = true;
+        return false;
       }
-      work["events"] = events;
-      works[it.first] = work;
-    }
-  }
-  json11::Json::object relations;
-  if (!graph->relations.empty()) {
-    for (auto &it: graph->relations) {
-      json11::Json::object relation{
-              {"id",          it.second.id},
-              {"w1",          it.second.w1},
-              {"w2",          it.second.w2},
-              {"description", it.second.description}};
-      relations[it.first] = relation;
+      rows_++;
+      return true;
     }
-  }
-  g["works"] = works;
-  g["relations"] = relations;
-  json11::Json json = g;
-  std::string data = json.dump();
-  return data;
-}
 
-int GraphManager::SaveGraph(Graph *graph) {
-  std::string json_data = DumpGraph(graph);
-  std::stringstream s;
-  s << kGraphPrefix << graph->id;
-  auto status = db_->Put(leveldb::WriteOptions{}, s.str(), json_data);
-  if (!status.ok()) {
-    std::cerr << "put failed: %v" << std::endl;
-    return 1;
-  }
-  return 0;
-}
-
-int GraphManager::GetGraph(Graph *g, int gi) {
-  std::stringstream k;
-  k << kGraphPrefix << gi;
-  auto iterator = db_->NewIterator(leveldb::ReadOptions{});
-  iterator->Seek(kGraphPrefix);
-  while (iterator->Valid()) {
-    if (iterator->key() == k.str()) {
-      json11::Json json = json11::Json();
-      std::string err;
-      json = json.parse(iterator->value().ToString(), err);
-      parseGraph(json.object_items(), g);
-      delete iterator;
-      return 0;
+    void End(const std::string &cursor) const {
+      if (more_) {
+        std::cerr << "next page: --after=" << cursor << std::endl;
+      }
     }
-    iterator->Next();
-  }
-  delete iterator;
-  return -1;
-}
 
-int GraphManager::DeleteGraph(int id) {
-  std::stringstream s;
-  s << kGraphPrefix << id;
-  auto status = db_->Delete(leveldb::WriteOptions{}, s.str());
-  if (!status.ok()) {
-    return -1;
-  } else {
-    return 0;
-  }
-}
+private:
+    int limit_;
+    int rows_;
+    bool more_;
+};
 
-void CreateGraph(GraphManager *gm, std::string gn) {
-  std::vector<Graph *> graphs;
-  gm->ListGraph(&graphs);
-  int max = 0;
-  for (auto it = graphs.begin(); it != graphs.end(); it++) {
-    if (max < (*it)->id) {
-      max = (*it)->id;
-    }
-    delete *it;
-  }
+int CreateGraph(GraphManager *gm, std::string gn) {
   Graph new_graph;
-  new_graph.id = max + 1;
   new_graph.name = gn;
-  int ret = gm->SaveGraph(&new_graph);
+  int ret = gm->CreateGraph(&new_graph);
   if (ret == 0) {
     std::cout << "create graph success" << std::endl;
   } else {
     std::cout << "create graph failed" << std::endl;
+    return 1;
   }
+  return 0;
 }
 
-void ListGraph(GraphManager *gm) {
-  std::vector<Graph *> graphs;
-  gm->ListGraph(&graphs);
-
-  std::printf("%-10s %-30s\n", "id", "graph_name");
-  for (auto it = graphs.begin(); it != graphs.end(); it++) {
-    std::printf("%-10d %-30s\n", (*it)->id, (*it)->name.c_str());
-    delete *it;
-  }
+int ListGraph(GraphManager *gm, int after, int limit, TableFormat format) {
+  flushStdio();
+  BufferedWriter out(STDOUT_FILENO);
+  Table table(&out, {{"id", 10, false}, {"graph_name", 30, false}}, 1, false, format);
+  table.Header();
+  Page page(limit);
+  int last = after;
+  gm->ScanGraphs([&](const GraphView &graph) {
+    if (!page.Add()) {
+      return kPageFull;
+    }
+    table.Cell(graph.id);
+    table.Cell(graph.name.data(), graph.name.size());
+    table.EndRow();
+    last = graph.id;
+    return 0;
+  }, after);
+  bool ok = table.Flush();
+  page.End(std::to_string(last));
+  return ok ? 0 : 1;
 }
 
-void DeleteGraph(GraphManager *gm, int id) {
+int DeleteGraph(GraphManager *gm, int id) {
   if (gm->DeleteGraph(id) != 0) {
     std::cout << "delete graph failed!" << std::endl;
+    return 1;
   } else {
     std::cout << "delete graph success!" << std::endl;
   }
+  return 0;
 }
 
 
-void CreateWork(GraphManager *gm, int gi, std::string wc, Status ws, int wp, std::string wrp) {
+int CreateWork(GraphManager *gm, int gi, std::string wc, Status ws, int wp, std::string wrp) {
   if (wc.empty()) {
     std::cerr << "work content is empty" << std::endl;
-    return;
-  }
-  Graph g;
-  int ret = gm->GetGraph(&g, gi);
-  if (ret != 0) {
-    std::cerr << "get graph failed: %v" << std::endl;
-    return;
-  }
-  int max_wd = 0;
-  for (auto it = g.works.begin(); it != g.works.end(); it++) {
-    if (it->second.id > max_wd) {
-      max_wd = it->second.id;
-    }
+    return 1;
   }
   Work new_work = Work{};
-  new_work.id = max_wd + 1;
   new_work.content = wc;
   new_work.status = ws;
   new_work.priority = wp;
-  time_t t = time(NULL);
-  struct tm *tm_local = localtime(&t);
-  new_work.updatedAt = *tm_local;
+  new_work.updatedAt = nowMicros();
 
   while (!wrp.empty()) {
     int idx = wrp.find(',');
@@ -356,45 +173,33 @@ void CreateWork(GraphManager *gm, int gi, std::string wc, Status ws, int wp, std
       break;
     }
   }
-  std::stringstream k;
-  k << kWorkPrefix << new_work.id;
-  g.works[k.str()] = new_work;
-  if (gm->SaveGraph(&g) == 0) {
+  if (gm->CreateWork(gi, &new_work) == 0) {
     std::cout << "create work success!" << std::endl;
   } else {
     std::cout << "create work failed!" << std::endl;
+    return 1;
   }
+  return 0;
 }
 
-void UpdateWork(GraphManager *gm, int gi, int wi, std::string wc, Status ws, int wp, std::string wrp) {
-  Graph g;
-  int ret = gm->GetGraph(&g, gi);
+int UpdateWork(GraphManager *gm, int gi, int wi, std::string wc, Status ws, int wp, std::string wrp) {
+  Work work = Work{};
+  int ret = gm->GetWork(gi, wi, &work);
   if (ret != 0) {
-    std::cerr << "get graph failed: %v" << std::endl;
-    return;
+    std::cerr << "get work failed" << std::endl;
+    return 1;
   }
-  Work *w;
-  for (auto &it: g.works) {
-    if (it.second.id == wi) {
-      w = &(it.second);
-    }
+  Work *w = &work;
+  if (!wc.empty()) {
+    w->content = wc;
   }
-  if (w) {
-    if (!wc.empty()) {
-      w->content = wc;
-    }
-    if (ws != kStart) {
-      w->status = ws;
-    }
-    if (wp != 0) {
-      w->priority = wp;
-    }
-    time_t t = time(NULL);
-    struct tm *tm_local = localtime(&t);
-    w->updatedAt = *tm_local;
-  } else {
-    return;
+  if (ws != kStart) {
+    w->status = ws;
   }
+  if (wp != 0) {
+    w->priority = wp;
+  }
+  w->updatedAt = nowMicros();
   while (!wrp.empty()) {
     w->related_people.clear();
     int idx = wrp.find(',');
@@ -406,354 +211,573 @@ void UpdateWork(GraphManager *gm, int gi, int wi, std::string wc, Status ws, int
       break;
     }
   }
-  if (gm->SaveGraph(&g) == 0) {
+  if (gm->SaveWork(gi, w) == 0) {
     std::cout << "update work success!" << std::endl;
   } else {
     std::cout << "update work failed!" << std::endl;
+    return 1;
   }
+  return 0;
 }
 
 
-void DeleteWork(GraphManager *gm, int gi, int wi) {
-  Graph g;
-  int ret = gm->GetGraph(&g, gi);
-  if (ret != 0) {
-    std::cerr << "get graph failed: %v" << std::endl;
-    return;
-  }
-  std::stringstream k;
-  k << kWorkPrefix << wi;
-  auto it = g.works.find(k.str());
-  if (it != g.works.end()) {
-    g.works.erase(it);
+int DeleteWork(GraphManager *gm, int gi, int wi) {
+  if (gm->DeleteWork(gi, wi) == 0) {
     std::cout << "delete work success" << std::endl;
   } else {
     std::cout << "delete work failed" << std::endl;
+    return 1;
   }
-  gm->SaveGraph(&g);
+  return 0;
 }
 
-bool CompareWork(Work &w1, Work &w2) {
-  return w1.id < w2.id;
+void addWork(Table *table, int id, int priority, int status, int64_t updatedAt, int events,
+             leveldb::Slice content) {
+  char buf[64];
+  table->Cell(id);
+  table->Cell(priority);
+  table->Cell(status);
+  table->Cell(buf, formatTime(buf, sizeof(buf), updatedAt));
+  table->Cell(events);
+  table->Cell(content.data(), content.size());
+  table->EndRow();
 }
 
-void ListWork(GraphManager *gm, int gi) {
-  Graph g;
-  int ret = gm->GetGraph(&g, gi);
-  if (ret != 0) {
+int ListWork(GraphManager *gm, int gi, const WorkFilter &filter, int ci, int after, int limit, TableFormat format) {
+  std::vector<Work> works;
+  if (ci != 0 && gm->ListWorkAsOf(gi, ci, filter, &works) != 0) {
     std::cerr << "get graph failed: %v" << std::endl;
-    return;
+    return 1;
   }
-  std::printf("%-10s %-10s %-10s %-30s %-10s %-30s\n", "id", "priority", "status", "created_at", "event", "content");
-  std::vector<Work> works;
-  for (auto it = g.works.begin(); it != g.works.end(); it++) {
-    works.push_back(it->second);
-  }
-  std::sort(works.begin(), works.end(), CompareWork);
-  for (auto it = works.begin(); it != works.end(); it++) {
-    char buf[255];
-    formatTime(buf, 255, &it->updatedAt);
-    std::printf("%-10d %-10d %-10d %-30s %-10d %-30s\n",
-                it->id,
-                it->priority,
-                it->status,
-                buf,
-                it->events.size(),
-                it->content.c_str());
+  if (ci == 0 && !gm->HasGraph(gi)) {
+    std::cerr << "get graph failed: %v" << std::endl;
+    return 1;
   }
+  flushStdio();
+  BufferedWriter out(STDOUT_FILENO);
+  Table table(&out, {{"id", 10, false}, {"priority", 10, false}, {"status", 10, false}, {"created_at", 30, false},
+                     {"event", 10, false}, {"content", 30, false}}, 1, false, format);
+  table.Header();
+  Page page(limit);
+  int last = after;
+  int ret = 0;
+  if (ci == 0) {
+    // Rows are written straight from the iterator.
+    ret = gm->ScanWorks(gi, filter, [&](const WorkView &work) {
+      if (!page.Add()) {
+        return kPageFull;
+      }
+      addWork(&table, work.id, work.priority, work.status, work.updatedAt, gm->CountEvents(gi, work.id),
+              work.content);
+      last = work.id;
+      return 0;
+    }, kWorkFieldId | kWorkFieldContent | kWorkFieldStatus | kWorkFieldPriority | kWorkFieldUpdatedAt, after);
+  }
+  for (auto it = std::upper_bound(works.begin(), works.end(), after, [](int id, const Work &work) {
+    return id < work.id;
+  }); it != works.end() && page.Add(); it++) {
+    addWork(&table, it->id, it->priority, it->status, it->updatedAt, static_cast<int>(it->events.size()),
+            it->content);
+    last = it->id;
+  }
+  bool ok = table.Flush();
+  page.End(std::to_string(last));
+  return ok && (ret == 0 || ret == kPageFull) ? 0 : 1;
 }
 
 
-void CreateEvent(GraphManager *gm, int gi, int wi, std::string ec) {
+int CreateEvent(GraphManager *gm, int gi, int wi, std::string ec) {
   if (ec.empty()) {
     std::cerr << "event content is empty" << std::endl;
-    return;
-  }
-  Graph g;
-  int ret = gm->GetGraph(&g, gi);
-  if (ret != 0) {
-    std::cerr << "get graph failed: %v" << std::endl;
-    return;
-  }
-  std::stringstream s;
-  s << kWorkPrefix << wi;
-  auto work = g.works.find(s.str());
-  if (work != g.works.end()) {
-    int max_id = 0;
-    for (auto &it: work->second.events) {
-      if (it.id > max_id) {
-        max_id = it.id;
-      }
-    }
-    time_t t = time(NULL);
-    struct tm *tm_local = localtime(&t);
-    Event e = Event{max_id + 1, ec, *tm_local};
-    work->second.events.push_back(e);
+    return 1;
   }
-  if (gm->SaveGraph(&g) == 0) {
+  Event e = Event{0, ec, nowMicros()};
+  if (gm->CreateEvent(gi, wi, &e) == 0) {
     std::cout << "creat event success!" << std::endl;
   } else {
     std::cout << "create event failed!" << std::endl;
+    return 1;
   }
+  return 0;
 }
 
-void ListEvent(GraphManager *gm, int gi, int wi) {
-  Graph g;
-  int ret = gm->GetGraph(&g, gi);
-  if (ret != 0) {
-    std::cerr << "get graph failed: %v" << std::endl;
-    return;
-  }
-  std::stringstream s;
-  s << kWorkPrefix << wi;
-  auto work = g.works.find(s.str());
-  std::unique_ptr<char[]> buffer;
-  std::string sperate_line;
-  if (work != g.works.end()) {
-    buffer = std::unique_ptr<char[]>(new char[1000 * work->second.events.size()]);
-    int max_width = 0;
-    int off = 0;
-    for (auto &it: work->second.events) {
-      char buf[255];
-      formatTime(buf, 255, &it.createdAt);
-      int l = std::sprintf(buffer.get() + off, "%-10d %-30s %-30s\n", it.id, buf, it.content.c_str());
-      int width = getStrWidth(buffer.get() + off);
-      off += l;
-      if (width > max_width) {
-        max_width = width;
-      }
+int ListEvent(GraphManager *gm, int gi, int wi, int ci, int after, int limit, TableFormat format) {
+  // The rules are as wide as the widest row, so the text table is held until
+  // all events of the page are read; event contents are copied only into it.
+  // Without --page that is the whole history of the work. The other formats
+  // are written as the events are read.
+  flushStdio();
+  BufferedWriter out(STDOUT_FILENO);
+  Table table(&out, {{"id", 10, false}, {"created_at", 30, false}, {"content", 30, false}}, 1, true, format);
+  table.Rule();
+  table.Header();
+  table.Rule();
+  int work_id = 0;
+  std::string work_content;
+  Page page(limit);
+  int last = after;
+  auto addEvent = [&](int id, int64_t createdAt, leveldb::Slice content) {
+    if (!page.Add()) {
+      return kPageFull;
     }
-    int i = 0;
-    while (i < max_width) {
-      sperate_line.append("-");
-      i += SperatorWidth;
+    char buf[64];
+    table.Cell(id);
+    table.Cell(buf, formatTime(buf, sizeof(buf), createdAt));
+    table.Cell(content.data(), content.size());
+    table.EndRow();
+    last = id;
+    return 0;
+  };
+  int ret;
+  if (ci == 0) {
+    ret = gm->ScanWork(gi, wi, [&](const WorkView &work) {
+      work_id = work.id;
+      work_content = work.content.ToString();
+      return 0;
+    }, [&](const EventView &event) {
+      return addEvent(event.id, event.createdAt, event.content);
+    }, kWorkFieldId | kWorkFieldContent, kEventFieldsAll, after);
+  } else {
+    Work work = Work{};
+    ret = gm->GetWorkAsOf(gi, wi, ci, &work);
+    if (ret == 0) {
+      work_id = work.id;
+      work_content = work.content;
+      for (auto &it: work.events) {
+        if (it.id > after && addEvent(it.id, it.createdAt, it.content) != 0) {
+          break;
+        }
+      }
     }
-    sperate_line.append("\n");
-
   }
-  std::cout << sperate_line;
-  std::printf("%-10s %-30s %-30s\n", "id", "created_at", "content");
-  std::cout << sperate_line;
-  std::printf(buffer.get());
-  std::cout << sperate_line;
-  std::cout << "work-id=" << work->second.id << "     " << "work-content=" << work->second.content << std::endl;
-  std::cout << sperate_line;
+  if (ret != 0 && ret != kPageFull) {
+    std::cerr << "get work failed" << std::endl;
+    return 1;
+  }
+  table.Rule();
+  table.Line("work-id=" + std::to_string(work_id) + "     work-content=" + work_content);
+  table.Rule();
+  bool ok = table.Flush();
+  page.End(std::to_string(last));
+  return ok ? 0 : 1;
 }
 
-void ListEventOffset(GraphManager *gm, int gi, int offset) {
-  Graph g;
-  int ret = gm->GetGraph(&g, gi);
-  if (ret != 0) {
+void addEventOffset(Table *table, int wi, leveldb::Slice workContent, int ei, int64_t createdAt,
+                    leveldb::Slice content) {
+  char buf[64];
+  table->Cell(wi);
+  table->Cell(workContent.data(), workContent.size());
+  table->Cell(ei);
+  table->Cell(buf, formatTime(buf, sizeof(buf), createdAt));
+  table->Cell(content.data(), content.size());
+  table->EndRow();
+}
+
+// A page holds the next limit events of the time index. The text table groups
+// them by work like a full listing, so it holds the page, or every matching
+// event without --page; the other formats write each event in index order as
+// it is read.
+int ListEventOffset(GraphManager *gm, int gi, int offset, EventCursor cursor, int limit, TableFormat format) {
+  if (!gm->HasGraph(gi)) {
     std::cerr << "get graph failed: %v" << std::endl;
-    return;
+    return 1;
   }
   time_t now;
   time(&now);
+  int64_t since = (static_cast<int64_t>(now) - 3600 * 24 * static_cast<int64_t>(offset)) * 1000000 + 1;
+  flushStdio();
+  BufferedWriter out(STDOUT_FILENO);
+  // Every event repeats the content of its work.
+  Table table(&out, {{"worker-id", 10, false}, {"work-content", 10, true}, {"event-id", 10, false},
+                     {"event-created-at", 20, false}, {"event-content", 15, false}}, 5, true, format);
+  table.Rule();
+  table.Header();
+  table.Rule();
   std::map<std::string, Work> works;
-  int events = 0;
-  for (auto it = g.works.begin(); it != g.works.end(); it++) {
-    for (auto it1 = it->second.events.begin(); it1 != it->second.events.end(); it1++) {
-      time_t t1 = mktime(&it1->createdAt);
-      double diff = difftime(now, t1);
-      if (diff < 3600 * 24 * offset) {
-        auto work = works.find(it->first);
-        if (work == works.end()) {
-          Work w = Work{};
-          w.id = it->second.id;
-          w.content = it->second.content;
-          w.events.push_back(*it1);
-          works[it->first] = w;
-          events++;
-        } else {
-          works[it->first].events.push_back(*it1);
-          events++;
-        }
-      }
+  Page page(limit);
+  int ret = gm->ListEventSince(gi, since, [&](const WorkView &work, const EventView &event) {
+    if (!page.Add()) {
+      return kPageFull;
     }
-  }
-  int max_width = 0;
-  int max_c1 = 10;
-  int max_c2 = 10;
-  int max_c3 = 10;
-  int max_c4 = 20;
-  int max_c5 = 15;
-  for (auto work = works.begin(); work != works.end(); work++) {
-    for (auto &it: work->second.events) {
-      char buf[255];
-      formatTime(buf, 255, &it.createdAt);
-
-      int c1 = getStrWidth(std::to_string(work->second.id).c_str());
-      int c2 = getStrWidth(work->second.content.c_str());
-      int c3 = getStrWidth(std::to_string(it.id).c_str());
-      int c4 = getStrWidth(buf);
-      int c5 = getStrWidth(it.content.c_str());
-
-      if (c1 > max_c1) {
-        max_c1 = c1;
-      }
-      if (c2 > max_c2) {
-        max_c2 = c2;
-      }
-      if (c3 > max_c3) {
-        max_c3 = c3;
-      }
-      if (c4 > max_c4) {
-        max_c4 = c4;
-      }
-      if (c5 > max_c5) {
-        max_c5 = c5;
-      }
+    if (format != kFormatText) {
+      addEventOffset(&table, work.id, work.content, event.id, event.createdAt, event.content);
+      return 0;
     }
-  }
-  max_width = max_c1 + max_c2 + max_c3 + max_c4 + max_c5 + 20;
-  std::string seprate_line;
-  int i = 0;
-  while (i < max_width) {
-    seprate_line.append("-");
-    i += SperatorWidth;
-  }
-
-  seprate_line.append("\n");
-  std::cout << seprate_line;
-  std::string header[] = {"worker-id", "work-content", "event-id", "event-created-at", "event-content"};
-  int lengths[] = {max_c1, max_c2, max_c3, max_c4, max_c5};
-  for (int i = 0; i < 5; i++) {
-    std::printf("%s", header[i].c_str());
-    int l = header[i].length();
-    while (l < lengths[i] + 5) {
-      l++;
-      putchar(' ');
+    Work &grouped = works[kWorkPrefix + std::to_string(work.id)];
+    if (grouped.id == 0) {
+      MaterializeWork(work, &grouped);
     }
+    grouped.events.push_back(Event{});
+    MaterializeEvent(event, &grouped.events.back());
+    return 0;
+  }, &cursor);
+  if (ret != 0 && ret != kPageFull) {
+    std::cerr << "list events failed" << std::endl;
+    return 1;
   }
-  printf("\n");
-  std::cout << seprate_line;
-
   for (auto work = works.begin(); work != works.end(); work++) {
     for (auto &it: work->second.events) {
-      char buf[255];
-      formatTime(buf, 255, &it.createdAt);
-      int c1 = getStrWidth(std::to_string(work->second.id).c_str());
-      int c2 = getStrWidth(work->second.content.c_str());
-      int c3 = getStrWidth(std::to_string(it.id).c_str());
-      int c4 = getStrWidth(buf);
-      int c5 = getStrWidth(it.content.c_str());
-      std::string work_id = std::to_string(work->second.id);
-      std::string event_id = std::to_string(it.id);
-      char *row[] = {const_cast<char *>(work_id.c_str()),
-                     const_cast<char *>(work->second.content.c_str()),
-                     const_cast<char *>(event_id.c_str()),
-                     buf,
-                     const_cast<char *>(it.content.c_str())
-      };
-      int lengths[] = {c1, c2, c3, c4, c5};
-      int max_lengths[] = {max_c1, max_c2, max_c3, max_c4, max_c5};
-      for (int i = 0; i < 5; i++) {
-        std::printf("%s", row[i]);
-        while (lengths[i] < max_lengths[i] + 5) {
-          lengths[i]++;
-          putchar(' ');
-        }
-      }
-      printf("\n");
+      addEventOffset(&table, work->second.id, work->second.content, it.id, it.createdAt, it.content);
     }
   }
-  std::cout << seprate_line << std::endl;
+  table.Rule();
+  table.Line("");
+  bool ok = table.Flush();
+  page.End(std::to_string(cursor.createdAt) + "-" + std::to_string(cursor.wi) + "-" + std::to_string(cursor.ei));
+  return ok ? 0 : 1;
 }
 
-void DeleteEvent(GraphManager *gm, int gi, int wi, int ei) {
-
-  Graph g;
-  int ret = gm->GetGraph(&g, gi);
-  if (ret != 0) {
-    std::cerr << "get graph failgzbh-ns-map-na029.gzbh.baidu.comed: %v" << std::endl;
-    return;
-  }
-  std::stringstream s;
-  s << kWorkPrefix << wi;
-  auto work = g.works.find(s.str());
-  if (work != g.works.end()) {
-    for (auto it = work->second.events.begin(); it < work->second.events.end(); it++) {
-      if (it->id == ei) {
-        work->second.events.erase(it);
-      }
-    }
-  }
-  if (gm->SaveGraph(&g) == 0) {
+int DeleteEvent(GraphManager *gm, int gi, int wi, int ei) {
+  if (gm->DeleteEvent(gi, wi, ei) == 0) {
     std::cout << "delete event success!" << std::endl;
   } else {
     std::cout << " delete event failed!" << std::endl;
+    return 1;
   }
+  return 0;
 }
 
-int main(int argc, char **argv) {
-  setlocale(LC_ALL, "");
-  char * home;
-  if ((home=getenv("HOME"))== nullptr && FLAGS_dd.empty()) {
-    std::cerr << "env $HOME or data storage dir must be set";
+int Search(GraphManager *gm, int gi, const std::string &q, bool works, bool events, int limit) {
+  if (q.empty()) {
+    std::cerr << "search query is empty" << std::endl;
     return 1;
   }
-  if (FLAGS_dd.empty()) {
-    FLAGS_dd = getenv("HOME");
+  std::vector<SearchHit> hits;
+  int ret = gm->Search(gi, q, works, events, limit < 0 ? 0 : limit, &hits);
+  if (ret != 0) {
+    std::cerr << "search failed" << std::endl;
+    return 1;
   }
-  leveldb::DB *db;
-  leveldb::Options option;
-  option.create_if_missing = true;
-  leveldb::Status status = leveldb::DB::Open(option, FLAGS_dd+"/graph", &db);
-  if (!status.ok()) {
-    std::cerr << "open db failed: " << status.ToString() << std::endl;
+  std::printf("%-10s %-10s %-10s %-30s\n", "score", "work-id", "event-id", "content");
+  for (auto &it: hits) {
+    std::string event_id = it.ei == 0 ? "-" : std::to_string(it.ei);
+    std::printf("%-10.3f %-10d %-10s %-30s\n", it.score, it.wi, event_id.c_str(), it.content.c_str());
+  }
+  return 0;
+}
+
+int CreateCheckpoint(GraphManager *gm, int gi) {
+  int ci;
+  if (gm->GenerateGraphCheckpoint(gi, &ci) != 0) {
+    std::cout << "create checkpoint failed!" << std::endl;
     return 1;
   }
-  GraphManager p = GraphManager(db);
+  std::cout << "create checkpoint " << ci << " success!" << std::endl;
+  return 0;
+}
 
-  gflags::ParseCommandLineFlags(&argc, &argv, true);
+int ListCheckpoint(GraphManager *gm, int gi, int after, int limit, TableFormat format) {
+  std::vector<Checkpoint> checkpoints;
+  if (gm->ListGraphCheckpoint(gi, &checkpoints, after) != 0) {
+    std::cerr << "get graph failed" << std::endl;
+    return 1;
+  }
+  flushStdio();
+  BufferedWriter out(STDOUT_FILENO);
+  Table table(&out, {{"id", 10, false}, {"created_at", 30, false}}, 1, false, format);
+  table.Header();
+  Page page(limit);
+  int last = after;
+  for (size_t i = 0; i < checkpoints.size() && page.Add(); i++) {
+    char buf[64];
+    table.Cell(checkpoints[i].id);
+    table.Cell(buf, formatTime(buf, sizeof(buf), checkpoints[i].createdAt));
+    table.EndRow();
+    last = checkpoints[i].id;
+  }
+  bool ok = table.Flush();
+  page.End(std::to_string(last));
+  return ok ? 0 : 1;
+}
 
-  if (argc != 3) {
-    std::cout << "wrong arguments" << std::endl;
+int DeleteCheckpoint(GraphManager *gm, int gi, int ci) {
+  if (gm->DeleteGraphCheckpoint(gi, ci) != 0) {
+    std::cout << "delete checkpoint failed!" << std::endl;
     return 1;
   }
+  std::cout << "delete checkpoint success!" << std::endl;
+  return 0;
+}
 
-  std::string action = argv[1];
-  std::string resource = argv[2];
+int RestoreCheckpoint(GraphManager *gm, int gi, int ci) {
+  if (gm->RestoreGraphCheckpoint(gi, ci) != 0) {
+    std::cout << "restore checkpoint failed!" << std::endl;
+    return 1;
+  }
+  std::cout << "restore checkpoint success!" << std::endl;
+  return 0;
+}
 
-  if (action == kCreate) {
+int RunRequest(GraphManager *gm, const std::vector<std::string> &args, const std::string *input = nullptr);
+
+// Runs a script (see batch.h) from path, - for stdin. A script from stdin
+// that was already read, as for the daemon, is passed as input. Mutations of
+// all commands are applied together with one WriteBatch at the end.
+int Batch(GraphManager *gm, const std::string &path, const std::string *input) {
+  std::istringstream script;
+  std::ifstream file;
+  std::istream *in = &script;
+  if (path == "-" && input != nullptr) {
+    script.str(*input);
+  } else {
+    file.open(path == "-" ? "/dev/stdin" : path);
+    if (!file) {
+      std::cerr << "open " << path << " failed" << std::endl;
+      return 1;
+    }
+    in = &file;
+  }
+  gm->BeginBatch();
+  int failed = RunScript(*in, [gm](const std::vector<std::string> &args) {
+    if (args[0] == kBatch) {
+      std::cerr << "batches can not be nested" << std::endl;
+      return 1;
+    }
+    return RunRequest(gm, args);
+  });
+  if (gm->CommitBatch() != 0) {
+    std::cerr << "commit batch failed" << std::endl;
+    return 1;
+  }
+  return failed == 0 ? 0 : 1;
+}
+
+std::string DBPath() {
+  return FLAGS_dd + "/graph";
+}
+
+leveldb::Options DBOptions() {
+  leveldb::Options option;
+  option.create_if_missing = true;
+  return option;
+}
+
+// The page size of li, which lists everything unless --page is given.
+int pageSize() {
+  return FLAGS_page < 0 ? 0 : FLAGS_page;
+}
+
+// Parses --after for the listings ordered by id.
+bool parseAfter(int *after) {
+  char *end;
+  long id = std::strtol(FLAGS_after.c_str(), &end, 10);
+  if (*end != '\0' || id < 0 || id > INT_MAX) {
+    std::cerr << "invalid --after: " << FLAGS_after << std::endl;
+    return false;
+  }
+  *after = static_cast<int>(id);
+  return true;
+}
+
+// Parses --after for li e --of, which continues at a position in the event
+// time index written as <created_at>-<work id>-<event id>.
+bool parseAfter(EventCursor *cursor) {
+  long long createdAt;
+  int n = 0;
+  if (!FLAGS_after.empty() &&
+      (std::sscanf(FLAGS_after.c_str(), "%lld-%d-%d%n", &createdAt, &cursor->wi, &cursor->ei, &n) != 3 ||
+       n != static_cast<int>(FLAGS_after.size()) || cursor->wi <= 0)) {
+    std::cerr << "invalid --after: " << FLAGS_after << std::endl;
+    return false;
+  }
+  if (n > 0) {
+    cursor->createdAt = createdAt;
+  }
+  return true;
+}
+
+// input holds the stdin of a command if it was read before, see Batch.
+int Run(GraphManager *gm, const std::string &action, const std::string &resource,
+        const std::string *input = nullptr) {
+  if (action == kBatch) {
+    return Batch(gm, resource, input);
+  } else if (action == kImport) {
+    return ImportEvents(gm, resource, FLAGS_threads);
+  } else if (action == kExport) {
+    return ExportGraphs(gm, FLAGS_gi, resource);
+  } else if (action == kCreate) {
     if (resource == kGraph) {
       if (FLAGS_gn.empty()) {
         std::cerr << "emtpy graph name" << std::endl;
         return 1;
       }
-      CreateGraph(&p, FLAGS_gn);
+      return CreateGraph(gm, FLAGS_gn);
     } else if (resource == kWork) {
-      CreateWork(&p, FLAGS_gi, FLAGS_wc, static_cast<Status>(FLAGS_ws), FLAGS_wp, FLAGS_wrp);
+      return CreateWork(gm, FLAGS_gi, FLAGS_wc, static_cast<Status>(FLAGS_ws), FLAGS_wp, FLAGS_wrp);
     } else if (resource == kEvent) {
-      CreateEvent(&p, FLAGS_gi, FLAGS_wi, FLAGS_ec);
+      return CreateEvent(gm, FLAGS_gi, FLAGS_wi, FLAGS_ec);
+    } else if (resource == kCheckpoint) {
+      return CreateCheckpoint(gm, FLAGS_gi);
     } else {
       std::cerr << "unknown resource: " << resource << std::endl;
+      return 1;
     }
   } else if (action == kList) {
+    int after = 0;
+    EventCursor cursor;
+    if (resource == kEvent && FLAGS_of >= 0 ? !parseAfter(&cursor) : !parseAfter(&after)) {
+      return 1;
+    }
+    TableFormat format;
+    if (!ParseTableFormat(FLAGS_format, &format)) {
+      std::cerr << "unknown format: " << FLAGS_format << std::endl;
+      return 1;
+    }
     if (resource == kGraph) {
-      ListGraph(&p);
+      return ListGraph(gm, after, pageSize(), format);
     } else if (resource == kWork) {
-      ListWork(&p, FLAGS_gi);
+      WorkFilter filter;
+      if (!gflags::GetCommandLineFlagInfoOrDie("ws").is_default) {
+        filter.status = FLAGS_ws;
+      }
+      if (!gflags::GetCommandLineFlagInfoOrDie("wp").is_default) {
+        filter.minPriority = FLAGS_wp;
+      }
+      filter.person = FLAGS_wrp;
+      return ListWork(gm, FLAGS_gi, filter, FLAGS_ci, after, pageSize(), format);
     } else if (resource == kEvent) {
       if (FLAGS_of < 0) {
-        ListEvent(&p, FLAGS_gi, FLAGS_wi);
+        return ListEvent(gm, FLAGS_gi, FLAGS_wi, FLAGS_ci, after, pageSize(), format);
       } else {
-        ListEventOffset(&p, FLAGS_gi, FLAGS_of);
+        return ListEventOffset(gm, FLAGS_gi, FLAGS_of, cursor, pageSize(), format);
       }
+    } else if (resource == kCheckpoint) {
+      return ListCheckpoint(gm, FLAGS_gi, after, pageSize(), format);
     }
   } else if (action == kDelete) {
     if (resource == kGraph) {
-      DeleteGraph(&p, FLAGS_gi);
+      return DeleteGraph(gm, FLAGS_gi);
     } else if (resource == kWork) {
-      DeleteWork(&p, FLAGS_gi, FLAGS_wi);
+      return DeleteWork(gm, FLAGS_gi, FLAGS_wi);
     } else if (resource == kEvent) {
-      DeleteEvent(&p, FLAGS_gi, FLAGS_wi, FLAGS_ei);
+      return DeleteEvent(gm, FLAGS_gi, FLAGS_wi, FLAGS_ei);
+    } else if (resource == kCheckpoint) {
+      return DeleteCheckpoint(gm, FLAGS_gi, FLAGS_ci);
     }
   } else if (action == kUpdate) {
     if (resource == kWork) {
-      UpdateWork(&p, FLAGS_gi, FLAGS_wi, FLAGS_wc, static_cast<Status>(FLAGS_ws), FLAGS_wp, FLAGS_wrp);
+      return UpdateWork(gm, FLAGS_gi, FLAGS_wi, FLAGS_wc, static_cast<Status>(FLAGS_ws), FLAGS_wp, FLAGS_wrp);
+    }
+  } else if (action == kRestore) {
+    if (resource == kCheckpoint) {
+      return RestoreCheckpoint(gm, FLAGS_gi, FLAGS_ci);
+    }
+  } else if (action == kSearch) {
+    if (resource == kGraph) {
+      return Search(gm, FLAGS_gi, FLAGS_q, true, true, FLAGS_limit);
+    } else if (resource == kWork) {
+      return Search(gm, FLAGS_gi, FLAGS_q, true, false, FLAGS_limit);
+    } else if (resource == kEvent) {
+      return Search(gm, FLAGS_gi, FLAGS_q, false, true, FLAGS_limit);
+    } else {
+      std::cerr << "unknown resource: " << resource << std::endl;
+      return 1;
     }
   } else {
     std::cerr << "unknown action: " << action << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int OpenManager(std::unique_ptr<GraphManager> *gm) {
+  leveldb::DB *db;
+  leveldb::Status status = leveldb::DB::Open(DBOptions(), DBPath(), &db);
+  if (!status.ok()) {
+    std::cerr << "open db failed: " << status.ToString() << std::endl;
+    return 1;
+  }
+  gm->reset(new GraphManager(db));
+  if ((*gm)->Migrate() != 0) {
+    std::cerr << "migrate storage layout failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Handles one daemon request: args are action, resource and the flags the
+// client set explicitly as name=value. Flags are restored afterwards so
+// requests do not leak into each other.
+int RunRequest(GraphManager *gm, const std::vector<std::string> &args, const std::string *input) {
+  if (args.size() < 2) {
+    std::cout << "wrong arguments" << std::endl;
+    return 1;
+  }
+  gflags::FlagSaver saver;
+  for (size_t i = 2; i < args.size(); i++) {
+    size_t eq = args[i].find('=');
+    if (eq == std::string::npos ||
+        gflags::SetCommandLineOption(args[i].substr(0, eq).c_str(), args[i].c_str() + eq + 1).empty()) {
+      std::cerr << "invalid flag: " << args[i] << std::endl;
+      return 1;
+    }
+  }
+  return Run(gm, args[0], args[1], input);
+}
+
+int main(int argc, char **argv) {
+  setlocale(LC_ALL, "");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  char * home;
+  if ((home=getenv("HOME"))== nullptr && FLAGS_dd.empty()) {
+    std::cerr << "env $HOME or data storage dir must be set";
+    return 1;
+  }
+  if (FLAGS_dd.empty()) {
+    FLAGS_dd = getenv("HOME");
+  }
+  std::string sock = FLAGS_sock.empty() ? FLAGS_dd + "/graph.sock" : FLAGS_sock;
+
+  if (FLAGS_daemon) {
+    std::unique_ptr<GraphManager> gm;
+    if (OpenManager(&gm) != 0) {
+      return 1;
+    }
+    return ServeDaemon(sock, [&gm](const std::vector<std::string> &args, const std::string &input) {
+      return RunRequest(gm.get(), args, &input);
+    });
+  }
+
+  if (argc != 3) {
+    std::cout << "wrong arguments" << std::endl;
+    return 1;
+  }
+
+  std::string action = argv[1];
+  std::string resource = argv[2];
+  // The daemon may run in another directory.
+  char cwd[PATH_MAX];
+  if ((action == kBatch || action == kImport || action == kExport) && resource != "-" && resource[0] != '/' && getcwd(cwd, sizeof(cwd)) != nullptr) {
+    resource = std::string(cwd) + "/" + resource;
+  }
+  std::vector<std::string> args = {action, resource};
+  std::vector<gflags::CommandLineFlagInfo> flags;
+  gflags::GetAllFlags(&flags);
+  for (auto &it: flags) {
+    // flagfile and friends have already been expanded into the other flags.
+    if (!it.is_default && it.name != "dd" && it.name != "sock" && it.name != "flagfile" &&
+        it.name != "fromenv" && it.name != "tryfromenv" && it.name != "undefok") {
+      args.push_back(it.name + "=" + it.current_value);
+    }
+  }
+  // The daemon does not read the stdin of its clients, so a script from stdin
+  // is read here when a daemon may be listening.
+  std::string input;
+  bool buffered = action == kBatch && resource == "-" && access(sock.c_str(), F_OK) == 0;
+  if (buffered) {
+    std::ostringstream script;
+    script << std::cin.rdbuf();
+    input = script.str();
+  }
+  int code;
+  if (RunRemote(sock, args, input, &code)) {
+    return code;
+  }
+
+  std::unique_ptr<GraphManager> gm;
+  if (OpenManager(&gm) != 0) {
+    return 1;
   }
+  return Run(gm.get(), action, resource, buffered ? &input : nullptr);
 }
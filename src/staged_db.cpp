@@ -0,0 +1,239 @@
+#include <iterator>
+
+#include "leveldb/iterator.h"
+#include "staged_db.h"
+
+namespace {
+
+// Merges a base iterator with the staged entries. Staged entries win over
+// base keys with the same name and deleted entries are skipped.
+class MergedIterator : public leveldb::Iterator {
+public:
+    typedef std::map<std::string, StagedDB::Entry> Entries;
+
+    MergedIterator(leveldb::Iterator *base, const Entries *entries)
+            : base_(base), entries_(entries), staged_(entries->end()), current_(kNone), forward_(true) {}
+
+    ~MergedIterator() override { delete base_; }
+
+    bool Valid() const override { return current_ != kNone; }
+
+    void SeekToFirst() override {
+      base_->SeekToFirst();
+      staged_ = entries_->begin();
+      settleForward();
+    }
+
+    void SeekToLast() override {
+      base_->SeekToLast();
+      staged_ = entries_->empty() ? entries_->end() : std::prev(entries_->end());
+      settleBackward();
+    }
+
+    void Seek(const leveldb::Slice &target) override {
+      base_->Seek(target);
+      staged_ = entries_->lower_bound(target.ToString());
+      settleForward();
+    }
+
+    void Next() override {
+      if (!forward_) {
+        // Reposition both sources just after the current key.
+        std::string k = key().ToString();
+        base_->Seek(k);
+        if (base_->Valid() && base_->key() == leveldb::Slice(k)) {
+          base_->Next();
+        }
+        staged_ = entries_->upper_bound(k);
+        settleForward();
+        return;
+      }
+      if (current_ == kBase) {
+        base_->Next();
+      } else {
+        ++staged_;
+      }
+      settleForward();
+    }
+
+    void Prev() override {
+      if (forward_) {
+        // Reposition both sources just before the current key.
+        std::string k = key().ToString();
+        base_->Seek(k);
+        if (base_->Valid()) {
+          base_->Prev();
+        } else {
+          base_->SeekToLast();
+        }
+        staged_ = entries_->lower_bound(k);
+        stepBack();
+        settleBackward();
+        return;
+      }
+      if (current_ == kBase) {
+        base_->Prev();
+      } else {
+        stepBack();
+      }
+      settleBackward();
+    }
+
+    leveldb::Slice key() const override {
+      return current_ == kBase ? base_->key() : leveldb::Slice(staged_->first);
+    }
+
+    leveldb::Slice value() const override {
+      return current_ == kBase ? base_->value() : leveldb::Slice(staged_->second.value);
+    }
+
+    leveldb::Status status() const override { return base_->status(); }
+
+private:
+    enum Source {
+        kNone,
+        kBase,
+        kStaged,
+    };
+
+    leveldb::Iterator *base_;
+    const Entries *entries_;
+    // Current staged entry; end() when exhausted in either direction.
+    Entries::const_iterator staged_;
+    Source current_;
+    bool forward_;
+
+    void stepBack() {
+      staged_ = staged_ == entries_->begin() ? entries_->end() : std::prev(staged_);
+    }
+
+    void settleForward() {
+      forward_ = true;
+      for (;;) {
+        bool hasBase = base_->Valid();
+        bool hasStaged = staged_ != entries_->end();
+        if (!hasBase && !hasStaged) {
+          current_ = kNone;
+          return;
+        }
+        int c = !hasBase ? 1 : !hasStaged ? -1 : base_->key().compare(staged_->first);
+        if (c < 0) {
+          current_ = kBase;
+          return;
+        }
+        if (c == 0) {
+          base_->Next();
+        }
+        if (staged_->second.deleted) {
+          ++staged_;
+          continue;
+        }
+        current_ = kStaged;
+        return;
+      }
+    }
+
+    void settleBackward() {
+      forward_ = false;
+      for (;;) {
+        bool hasBase = base_->Valid();
+        bool hasStaged = staged_ != entries_->end();
+        if (!hasBase && !hasStaged) {
+          current_ = kNone;
+          return;
+        }
+        int c = !hasBase ? -1 : !hasStaged ? 1 : base_->key().compare(staged_->first);
+        if (c > 0) {
+          current_ = kBase;
+          return;
+        }
+        if (c == 0) {
+          base_->Prev();
+        }
+        if (staged_->second.deleted) {
+          stepBack();
+          continue;
+        }
+        current_ = kStaged;
+        return;
+      }
+    }
+};
+
+class StageHandler : public leveldb::WriteBatch::Handler {
+public:
+    StageHandler(std::map<std::string, StagedDB::Entry> *entries) : entries_(entries), count_(0) {}
+
+    void Put(const leveldb::Slice &key, const leveldb::Slice &value) override {
+      (*entries_)[key.ToString()] = StagedDB::Entry{false, value.ToString()};
+      count_++;
+    }
+
+    void Delete(const leveldb::Slice &key) override {
+      (*entries_)[key.ToString()] = StagedDB::Entry{true, std::string()};
+      count_++;
+    }
+
+    size_t count() const { return count_; }
+
+private:
+    std::map<std::string, StagedDB::Entry> *entries_;
+    size_t count_;
+};
+
+}  // namespace
+
+leveldb::Status StagedDB::Put(const leveldb::WriteOptions &options, const leveldb::Slice &key,
+                              const leveldb::Slice &value) {
+  leveldb::WriteBatch batch;
+  batch.Put(key, value);
+  return Write(options, &batch);
+}
+
+leveldb::Status StagedDB::Delete(const leveldb::WriteOptions &options, const leveldb::Slice &key) {
+  leveldb::WriteBatch batch;
+  batch.Delete(key);
+  return Write(options, &batch);
+}
+
+leveldb::Status StagedDB::Write(const leveldb::WriteOptions &, leveldb::WriteBatch *updates) {
+  StageHandler handler(&entries_);
+  auto status = updates->Iterate(&handler);
+  if (!status.ok()) {
+    return status;
+  }
+  pending_ += handler.count();
+  return status;
+}
+
+leveldb::Status StagedDB::Get(const leveldb::ReadOptions &options, const leveldb::Slice &key, std::string *value) {
+  auto it = entries_.find(key.ToString());
+  if (it == entries_.end()) {
+    return base_->Get(options, key, value);
+  }
+  if (it->second.deleted) {
+    return leveldb::Status::NotFound(key);
+  }
+  *value = it->second.value;
+  return leveldb::Status::OK();
+}
+
+leveldb::Iterator *StagedDB::NewIterator(const leveldb::ReadOptions &options) {
+  return new MergedIterator(base_->NewIterator(options), &entries_);
+}
+
+leveldb::Status StagedDB::Commit(const leveldb::WriteOptions &options) {
+  // Only the last version of each key is staged, in key order.
+  leveldb::WriteBatch batch;
+  for (auto &it: entries_) {
+    if (it.second.deleted) {
+      batch.Delete(it.first);
+    } else {
+      batch.Put(it.first, it.second.value);
+    }
+  }
+  auto status = base_->Write(options, &batch);
+  entries_.clear();
+  pending_ = 0;
+  return status;
+}
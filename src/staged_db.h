@@ -0,0 +1,65 @@
+#ifndef GRAPH_STAGED_DB_H_
+#define GRAPH_STAGED_DB_H_
+
+#include <map>
+#include <string>
+
+#include "leveldb/db.h"
+#include "leveldb/write_batch.h"
+
+// StagedDB collects writes in memory on top of a base DB instead of applying
+// them. Reads see the staged writes, so code written against leveldb::DB
+// (id allocation, index maintenance) behaves as if every write had been
+// applied, while Commit hands them to the base DB as one atomic WriteBatch.
+// The base DB is not owned.
+class StagedDB : public leveldb::DB {
+public:
+    StagedDB(leveldb::DB *base) : base_(base) {};
+
+    // Writes all staged changes to the base DB and clears the stage.
+    leveldb::Status Commit(const leveldb::WriteOptions &options);
+
+    // Number of staged Put and Delete operations.
+    size_t Pending() const { return pending_; }
+
+    leveldb::Status Put(const leveldb::WriteOptions &options, const leveldb::Slice &key,
+                        const leveldb::Slice &value) override;
+
+    leveldb::Status Delete(const leveldb::WriteOptions &options, const leveldb::Slice &key) override;
+
+    leveldb::Status Write(const leveldb::WriteOptions &options, leveldb::WriteBatch *updates) override;
+
+    leveldb::Status Get(const leveldb::ReadOptions &options, const leveldb::Slice &key,
+                        std::string *value) override;
+
+    leveldb::Iterator *NewIterator(const leveldb::ReadOptions &options) override;
+
+    const leveldb::Snapshot *GetSnapshot() override { return base_->GetSnapshot(); }
+
+    void ReleaseSnapshot(const leveldb::Snapshot *snapshot) override { base_->ReleaseSnapshot(snapshot); }
+
+    bool GetProperty(const leveldb::Slice &property, std::string *value) override {
+      return base_->GetProperty(property, value);
+    }
+
+    void GetApproximateSizes(const leveldb::Range *range, int n, uint64_t *sizes) override {
+      base_->GetApproximateSizes(range, n, sizes);
+    }
+
+    void CompactRange(const leveldb::Slice *begin, const leveldb::Slice *end) override {
+      base_->CompactRange(begin, end);
+    }
+
+    // A staged value; deleted entries hide the key in the base DB.
+    struct Entry {
+        bool deleted;
+        std::string value;
+    };
+
+private:
+    leveldb::DB *base_;
+    std::map<std::string, Entry> entries_;
+    size_t pending_ = 0;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include <cstring>
+
+#include "table.h"
+
+bool ParseTableFormat(const std::string &name, TableFormat *format) {
+  if (name == "table") {
+    *format = kFormatText;
+  } else if (name == "ndjson") {
+    *format = kFormatNdjson;
+  } else if (name == "csv") {
+    *format = kFormatCsv;
+  } else if (name == "tsv") {
+    *format = kFormatTsv;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static void appendJsonString(const char *s, size_t n, std::string *out) {
+  static const char kHex[] = "0123456789abcdef";
+  out->push_back('"');
+  size_t start = 0;
+  for (size_t i = 0; i < n; i++) {
+    unsigned char c = static_cast<unsigned char>(s[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    out->append(s + start, i - start);
+    start = i + 1;
+    switch (c) {
+      case '"':
+        out->append("\\\"");
+        break;
+      case '\\':
+        out->append("\\\\");
+        break;
+      case '\n':
+        out->append("\\n");
+        break;
+      case '\r':
+        out->append("\\r");
+        break;
+      case '\t':
+        out->append("\\t");
+        break;
+      default:
+        out->append("\\u00");
+        out->push_back(kHex[c >> 4]);
+        out->push_back(kHex[c & 15]);
+        break;
+    }
+  }
+  out->append(s + start, n - start);
+  out->push_back('"');
+}
+
+static void appendCsvField(const char *s, size_t n, std::string *out) {
+  size_t i = 0;
+  while (i < n && s[i] != ',' && s[i] != '"' && s[i] != '\n' && s[i] != '\r') {
+    i++;
+  }
+  if (i == n) {
+    out->append(s, n);
+    return;
+  }
+  out->push_back('"');
+  for (i = 0; i < n; i++) {
+    if (s[i] == '"') {
+      out->push_back('"');
+    }
+    out->push_back(s[i]);
+  }
+  out->push_back('"');
+}
+
+static void appendTsvField(const char *s, size_t n, std::string *out) {
+  size_t start = 0;
+  for (size_t i = 0; i < n; i++) {
+    const char *escape;
+    switch (s[i]) {
+      case '\t':
+        escape = "\\t";
+        break;
+      case '\n':
+        escape = "\\n";
+        break;
+      case '\r':
+        escape = "\\r";
+        break;
+      case '\\':
+        escape = "\\\\";
+        break;
+      default:
+        continue;
+    }
+    out->append(s + start, i - start);
+    out->append(escape);
+    start = i + 1;
+  }
+  out->append(s + start, n - start);
+}
+
+Table::Table(BufferedWriter *out, std::vector<Column> columns, int gap, bool fit, TableFormat format)
+        : out_(out), columns_(std::move(columns)), caches_(columns_.size()), gap_(gap),
+          fit_(fit && format == kFormatText), format_(format), column_(0) {
+  for (auto &it: columns_) {
+    if (format_ == kFormatNdjson) {
+      keys_.push_back(keys_.empty() ? "{" : ",");
+      appendJsonString(it.header, std::strlen(it.header), &keys_.back());
+      keys_.back().push_back(':');
+    } else if (format_ == kFormatText) {
+      int width = getStrWidth(it.header);
+      widths_.push_back(fit_ && width > it.width ? width : it.width);
+    }
+  }
+}
+
+void Table::Cell(const char *s, size_t n) {
+  if (format_ != kFormatText) {
+    writeField(s, n, false);
+    column_++;
+    return;
+  }
+  int width = measure(s, n);
+  if (fit_) {
+    texts_.push_back(Text{text_.size(), n, width});
+    text_.append(s, n);
+    if (width > widths_[column_]) {
+      widths_[column_] = width;
+    }
+  } else {
+    write(s, n, width);
+  }
+  column_++;
+}
+
+void Table::Cell(int64_t v) {
+  char buf[24];
+  char *p = buf + sizeof(buf);
+  uint64_t u = v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+  do {
+    *--p = static_cast<char>('0' + u % 10);
+    u /= 10;
+  } while (u != 0);
+  if (v < 0) {
+    *--p = '-';
+  }
+  if (format_ != kFormatText) {
+    writeField(p, buf + sizeof(buf) - p, true);
+    column_++;
+  } else {
+    Cell(p, buf + sizeof(buf) - p);
+  }
+}
+
+void Table::EndRow() {
+  column_ = 0;
+  if (format_ == kFormatNdjson) {
+    out_->buffer()->push_back('}');
+  }
+  if (fit_) {
+    entries_.push_back(Entry{kRow, texts_.size() - columns_.size()});
+  } else {
+    out_->EndLine();
+  }
+}
+
+void Table::Header() {
+  if (format_ == kFormatNdjson) {
+    return;
+  }
+  if (format_ != kFormatText) {
+    for (column_ = 0; column_ < columns_.size(); column_++) {
+      writeField(columns_[column_].header, std::strlen(columns_[column_].header), false);
+    }
+    column_ = 0;
+    out_->EndLine();
+    return;
+  }
+  if (fit_) {
+    entries_.push_back(Entry{kHeader, 0});
+  } else {
+    writeEntry(Entry{kHeader, 0});
+  }
+}
+
+void Table::Rule() {
+  if (format_ != kFormatText) {
+    return;
+  }
+  if (fit_) {
+    entries_.push_back(Entry{kRule, 0});
+  } else {
+    writeEntry(Entry{kRule, 0});
+  }
+}
+
+void Table::Line(const std::string &text) {
+  if (format_ != kFormatText) {
+    return;
+  }
+  if (fit_) {
+    entries_.push_back(Entry{kLine, texts_.size()});
+    texts_.push_back(Text{text_.size(), text.size(), 0});
+    text_.append(text);
+  } else {
+    out_->buffer()->append(text);
+    out_->EndLine();
+  }
+}
+
+bool Table::Flush() {
+  for (auto &it: entries_) {
+    writeEntry(it);
+  }
+  entries_.clear();
+  texts_.clear();
+  text_.clear();
+  return out_->Flush();
+}
+
+int Table::measure(const char *s, size_t n) {
+  int width = columns_[column_].repeats ? caches_[column_].Width(s, n) : getStrWidth(s, n);
+  // Invalid UTF-8 is counted by bytes.
+  return width < 0 ? static_cast<int>(n) : width;
+}
+
+void Table::writeField(const char *s, size_t n, bool number) {
+  std::string *buffer = out_->buffer();
+  switch (format_) {
+    case kFormatNdjson:
+      buffer->append(keys_[column_]);
+      if (number) {
+        buffer->append(s, n);
+      } else {
+        appendJsonString(s, n, buffer);
+      }
+      break;
+    case kFormatCsv:
+      if (column_ > 0) {
+        buffer->push_back(',');
+      }
+      appendCsvField(s, n, buffer);
+      break;
+    case kFormatTsv:
+      if (column_ > 0) {
+        buffer->push_back('\t');
+      }
+      appendTsvField(s, n, buffer);
+      break;
+    case kFormatText:
+      break;
+  }
+}
+
+// Appends a cell of the current column with the padding up to the next one.
+void Table::write(const char *s, size_t n, int width) {
+  std::string *buffer = out_->buffer();
+  buffer->append(s, n);
+  if (column_ + 1 < columns_.size()) {
+    int pad = widths_[column_] - width;
+    buffer->append((pad > 0 ? pad : 0) + gap_, ' ');
+  }
+}
+
+void Table::writeEntry(const Entry &entry) {
+  switch (entry.kind) {
+    case kRow:
+      for (column_ = 0; column_ < columns_.size(); column_++) {
+        const Text &cell = texts_[entry.first + column_];
+        write(text_.data() + cell.offset, cell.size, cell.width);
+      }
+      break;
+    case kHeader:
+      for (column_ = 0; column_ < columns_.size(); column_++) {
+        const char *header = columns_[column_].header;
+        write(header, std::strlen(header), getStrWidth(header));
+      }
+      break;
+    case kRule:
+      out_->buffer()->append(tableWidth(), '-');
+      break;
+    case kLine:
+      out_->buffer()->append(text_, texts_[entry.first].offset, texts_[entry.first].size);
+      break;
+  }
+  column_ = 0;
+  out_->EndLine();
+}
+
+int Table::tableWidth() const {
+  int width = gap_ * static_cast<int>(columns_.size() - 1);
+  for (auto it: widths_) {
+    width += it;
+  }
+  return width;
+}
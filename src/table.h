@@ -0,0 +1,117 @@
+#ifndef GRAPH_TABLE_H_
+#define GRAPH_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "buffered_writer.h"
+#include "util.h"
+
+// Output formats of a Table. Besides the padded text layout, rows can be
+// written for other programs as JSON objects keyed by the column headers, one
+// per line, or as comma- or tab-separated values under a header line.
+enum TableFormat {
+    kFormatText,
+    kFormatNdjson,
+    kFormatCsv,
+    kFormatTsv,
+};
+
+// Parses a format name: table, ndjson, csv or tsv.
+bool ParseTableFormat(const std::string &name, TableFormat *format);
+
+// Lays out rows of cells as left-aligned columns separated by gap spaces,
+// padded by display width (getStrWidth), into a BufferedWriter. The last
+// column is not padded.
+//
+// A fitted table keeps its cells, each measured once as it is added, until
+// Flush and then widens every column to its widest cell; otherwise columns
+// keep their widths and rows are written as they end, so a cell wider than
+// its column pushes the rest of its row right, as printf's %-10s does. Rules
+// and lines are placed among the rows in the order they are added.
+//
+// In the other formats cells are escaped and written as they are added,
+// without measuring them; fit is ignored, and rules and lines are left out.
+// CSV fields are quoted as in RFC 4180 when needed; in TSV, tabs, line breaks
+// and backslashes are written as \t, \n, \r and \\.
+class Table {
+public:
+    struct Column {
+        const char *header;
+        int width;
+        bool repeats;  // the column repeats values, their widths are cached
+    };
+
+    Table(BufferedWriter *out, std::vector<Column> columns, int gap, bool fit, TableFormat format = kFormatText);
+
+    // Cells are added left to right; EndRow completes the row.
+    void Cell(const char *s, size_t n);
+
+    void Cell(const std::string &s) { Cell(s.data(), s.size()); }
+
+    void Cell(int64_t v);
+
+    void EndRow();
+
+    // A row of the column headers.
+    void Header();
+
+    // A line of '-' as wide as the table.
+    void Rule();
+
+    // A line written as is.
+    void Line(const std::string &text);
+
+    // Writes the rows a fitted table holds and flushes the writer; false if
+    // writing failed.
+    bool Flush();
+
+private:
+    enum Kind {
+        kRow,
+        kHeader,
+        kRule,
+        kLine,
+    };
+
+    // A cell or line of a fitted table, in text_.
+    struct Text {
+        size_t offset;
+        size_t size;
+        int width;
+    };
+
+    struct Entry {
+        Kind kind;
+        size_t first;  // the first cell of a row, or the line, in texts_
+    };
+
+    BufferedWriter *out_;
+    std::vector<Column> columns_;
+    std::vector<int> widths_;
+    std::vector<StrWidthCache> caches_;
+    int gap_;
+    bool fit_;
+    TableFormat format_;
+    // The text before each NDJSON value: {"key": or ,"key":
+    std::vector<std::string> keys_;
+    size_t column_;
+    std::string text_;
+    std::vector<Text> texts_;
+    std::vector<Entry> entries_;
+
+    int measure(const char *s, size_t n);
+
+    // Appends a cell in format_; numbers are not quoted in NDJSON.
+    void writeField(const char *s, size_t n, bool number);
+
+    void write(const char *s, size_t n, int width);
+
+    void writeEntry(const Entry &entry);
+
+    int tableWidth() const;
+};
+
+#endif
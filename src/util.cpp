@@ -1,26 +1,357 @@
-#include <cstdlib>
-#include <cwchar>
-#include <memory>
-#include <stdlib.h>
+#include <climits>
+#include <cstring>
+#include <vector>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
 
 #include "util.h"
+#include "width_table.h"
 
-int getStrWidth(const char* s) {
-    int wchar_len = std::mbstowcs(NULL, s, 0);
-    std::unique_ptr<wchar_t[]>  wchar_str(new wchar_t[wchar_len]);
-    if (std::mbstowcs(wchar_str.get(), s, wchar_len)==-1){
-        return -1;
+namespace {
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+// Returns the number of printable ASCII bytes at the start of [p, end).
+size_t printableAscii(const unsigned char* p, const unsigned char* end) {
+    const unsigned char* start = p;
+    const __m128i space = _mm_set1_epi8(0x1f), del = _mm_set1_epi8(0x7f);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        // Signed compares, so bytes >= 0x80 are below the space.
+        __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, space), _mm_cmplt_epi8(v, del));
+        unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(printable)) & 0xffff;
+        if (mask != 0) {
+            return p - start + __builtin_ctz(mask);
+        }
+    }
+    while (p < end && *p >= 0x20 && *p < 0x7f) {
+        p++;
+    }
+    return p - start;
+}
+#else
+size_t printableAscii(const unsigned char* p, const unsigned char* end) {
+    const unsigned char* start = p;
+    while (p < end && *p >= 0x20 && *p < 0x7f) {
+        p++;
     }
-    int width =0;
-    for (int i =0; i < wchar_len; i++) {
-        int w = wcwidth(wchar_str.get()[i]);
-        if (w>0) {
-            width+=w;
+    return p - start;
+}
+#endif
+
+// Decodes the UTF-8 sequence at p into c and returns its length, or 0 if it
+// is truncated, overlong, a surrogate or above U+10FFFF.
+int decodeUtf8(const unsigned char* p, const unsigned char* end, uint32_t* c) {
+    int len;
+    uint32_t min;
+    if (p[0] < 0x80) {
+        *c = p[0];
+        return 1;
+    } else if (p[0] >= 0xc2 && p[0] <= 0xdf) {
+        len = 2;
+        min = 0x80;
+        *c = p[0] & 0x1f;
+    } else if ((p[0] & 0xf0) == 0xe0) {
+        len = 3;
+        min = 0x800;
+        *c = p[0] & 0x0f;
+    } else if (p[0] >= 0xf0 && p[0] <= 0xf4) {
+        len = 4;
+        min = 0x10000;
+        *c = p[0] & 0x07;
+    } else {
+        return 0;
+    }
+    if (end - p < len) {
+        return 0;
+    }
+    for (int i = 1; i < len; i++) {
+        if ((p[i] & 0xc0) != 0x80) {
+            return 0;
         }
+        *c = (*c << 6) | (p[i] & 0x3f);
+    }
+    if (*c < min || *c > 0x10ffff || (*c >= 0xd800 && *c <= 0xdfff)) {
+        return 0;
     }
+    return len;
+}
+
+template <size_t N>
+bool inRanges(const WidthRange (&ranges)[N], uint32_t c) {
+    size_t lo = 0, hi = N;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (ranges[mid].last < c) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < N && ranges[lo].first <= c;
+}
+
+int charWidth(uint32_t c) {
+    if (c < 0x300) {
+        return c < 0x20 || (c >= 0x7f && c < 0xa0) ? 0 : 1;
+    }
+    // CJK ideographs and Hangul syllables, the bulk of wide text.
+    if ((c >= 0x4e00 && c <= 0x9fff) || (c >= 0xac00 && c <= 0xd7a3)) {
+        return 2;
+    }
+    if (inRanges(kDoubleWidth, c)) {
+        return 2;
+    }
+    return inRanges(kZeroWidth, c) ? 0 : 1;
+}
+
+const size_t kMaxCachedWidths = 4096;
+
+}  // namespace
+
+int getStrWidth(const char* s) {
+    return getStrWidth(s, std::strlen(s));
+}
+
+int getStrWidth(const char* s, size_t n) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s);
+    const unsigned char* end = p + n;
+    int width = 0;
+    while (p < end) {
+        size_t ascii = printableAscii(p, end);
+        width += static_cast<int>(ascii);
+        p += ascii;
+        if (p == end) {
+            break;
+        }
+        uint32_t c;
+        int len = decodeUtf8(p, end, &c);
+        if (len == 0) {
+            return -1;
+        }
+        width += charWidth(c);
+        p += len;
+    }
+    return width;
+}
+
+int StrWidthCache::Width(const char* s, size_t n) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s);
+    if (printableAscii(p, p + n) == n) {
+        return static_cast<int>(n);
+    }
+    key_.assign(s, n);
+    auto it = widths_.find(key_);
+    if (it != widths_.end()) {
+        return it->second;
+    }
+    if (widths_.size() >= kMaxCachedWidths) {
+        widths_.clear();
+    }
+    int width = getStrWidth(s, n);
+    widths_.emplace(key_, width);
     return width;
 }
 
-void formatTime(char* buf, int size, struct tm* t) {
-    strftime(buf, 255, "%Y-%m-%d %H:%M:%S", t);
-}
\ No newline at end of file
+// Local time is UTC plus an offset that only changes at timezone transitions.
+// The offset of each UTC day in [1970, 2100) is looked up once, when first
+// needed, and kept in a table; days with a transition, and times outside the
+// table, go to localtime_r. The tables and the caches of the formatter and
+// parser are per thread since the importer parses on several.
+namespace {
+
+const int64_t kSecondsPerDay = 86400;
+const int kTableDays = 47482;  // 1970-01-01 to 2100-01-01
+const int32_t kUnknown = INT32_MIN;
+const int32_t kTransition = INT32_MIN + 1;
+const char kTimeFormat[] = "%Y-%m-%d %H:%M:%S";
+const int kTimeLength = 19;
+const int kDateLength = 11;  // with the separating space
+
+thread_local std::vector<int32_t> offsetTable;
+
+// The last date formatted and parsed, as day numbers and text.
+struct DateCache {
+    int64_t day = INT64_MIN;
+    char text[kDateLength];
+};
+
+thread_local DateCache formatted;
+thread_local DateCache parsed;
+
+int64_t floorDiv(int64_t a, int64_t b) {
+    return a / b - (a % b < 0 ? 1 : 0);
+}
+
+long localtimeOffset(int64_t secs) {
+    struct tm t;
+    time_t at = static_cast<time_t>(secs);
+    localtime_r(&at, &t);
+    return t.tm_gmtoff;
+}
+
+int32_t dayOffset(int64_t day) {
+    long first = localtimeOffset(day * kSecondsPerDay);
+    long last = localtimeOffset((day + 1) * kSecondsPerDay - 1);
+    return first == last ? static_cast<int32_t>(first) : kTransition;
+}
+
+long utcOffset(int64_t secs) {
+    int64_t day = floorDiv(secs, kSecondsPerDay);
+    if (day >= 0 && day < kTableDays) {
+        std::vector<int32_t>& table = offsetTable;
+        if (table.empty()) {
+            table.assign(kTableDays, kUnknown);
+        }
+        if (table[day] == kUnknown) {
+            table[day] = dayOffset(day);
+        }
+        if (table[day] != kTransition) {
+            return table[day];
+        }
+    }
+    return localtimeOffset(secs);
+}
+
+// Converts between days since 1970-01-01 and proleptic Gregorian dates.
+void civilFromDays(int64_t days, int* y, int* m, int* d) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    *d = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    *m = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    *y = static_cast<int>(yoe + era * 400 + (*m <= 2 ? 1 : 0));
+}
+
+int64_t daysFromCivil(int y, int m, int d) {
+    y -= m <= 2 ? 1 : 0;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void put2(char* p, int v) {
+    p[0] = static_cast<char>('0' + v / 10);
+    p[1] = static_cast<char>('0' + v % 10);
+}
+
+// Reads n digits, or returns -1.
+int get(const char* p, int n) {
+    int v = 0;
+    for (int i = 0; i < n; i++) {
+        if (p[i] < '0' || p[i] > '9') {
+            return -1;
+        }
+        v = v * 10 + (p[i] - '0');
+    }
+    return v;
+}
+
+// Reads the zero-padded layout formatTime writes as seconds of local time
+// since the epoch; anything else, including out of range fields, is left to
+// strptime. Fields are checked in order so a short s is not read past its end.
+bool parseFixed(const char* s, int64_t* local) {
+    DateCache& date = parsed;
+    int64_t day;
+    if (date.day != INT64_MIN && std::strncmp(s, date.text, kDateLength) == 0) {
+        day = date.day;
+    } else {
+        int y, m, d;
+        if ((y = get(s, 4)) < 0 || s[4] != '-' || (m = get(s + 5, 2)) < 1 || m > 12 || s[7] != '-' ||
+            (d = get(s + 8, 2)) < 1 || d > 31 || s[10] != ' ') {
+            return false;
+        }
+        day = daysFromCivil(y, m, d);
+        std::memcpy(date.text, s, kDateLength);
+        date.day = day;
+    }
+    const char* t = s + kDateLength;
+    int h, m, sec;
+    if ((h = get(t, 2)) < 0 || h > 23 || t[2] != ':' || (m = get(t + 3, 2)) < 0 || m > 59 || t[5] != ':' ||
+        (sec = get(t + 6, 2)) < 0 || sec > 59 || t[8] != '\0') {
+        return false;
+    }
+    *local = day * kSecondsPerDay + h * 3600 + m * 60 + sec;
+    return true;
+}
+
+// For years formatTime has no fixed width for, and buffers it does not fit.
+int formatSlow(char* buf, int size, int64_t local) {
+    struct tm t;
+    time_t at = static_cast<time_t>(local);
+    gmtime_r(&at, &t);
+    return static_cast<int>(strftime(buf, size, kTimeFormat, &t));
+}
+
+}  // namespace
+
+int64_t nowMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+int formatTime(char* buf, int size, int64_t us) {
+    int64_t secs = floorDiv(us, 1000000);
+    int64_t local = secs + utcOffset(secs);
+    if (size <= kTimeLength) {
+        return formatSlow(buf, size, local);
+    }
+    int64_t day = floorDiv(local, kSecondsPerDay);
+    DateCache& date = formatted;
+    if (day != date.day) {
+        int y, m, d;
+        civilFromDays(day, &y, &m, &d);
+        if (y < 0 || y > 9999) {
+            return formatSlow(buf, size, local);
+        }
+        put2(date.text, y / 100);
+        put2(date.text + 2, y % 100);
+        date.text[4] = '-';
+        put2(date.text + 5, m);
+        date.text[7] = '-';
+        put2(date.text + 8, d);
+        date.text[10] = ' ';
+        date.day = day;
+    }
+    int rem = static_cast<int>(local - day * kSecondsPerDay);
+    std::memcpy(buf, date.text, kDateLength);
+    put2(buf + 11, rem / 3600);
+    buf[13] = ':';
+    put2(buf + 14, rem / 60 % 60);
+    buf[16] = ':';
+    put2(buf + 17, rem % 60);
+    buf[kTimeLength] = '\0';
+    return kTimeLength;
+}
+
+bool parseTime(const char* s, int64_t* us) {
+    int64_t local;
+    if (!parseFixed(s, &local)) {
+        struct tm t = tm{};
+        const char* end = strptime(s, kTimeFormat, &t);
+        if (end == nullptr || *end != '\0') {
+            return false;
+        }
+        local = static_cast<int64_t>(timegm(&t));
+    }
+    // The offset sought holds at local minus at most a day. If it is the same
+    // a day either side there is no transition in between; otherwise the time
+    // may be skipped or repeated and mktime decides.
+    long offset = utcOffset(local);
+    if (utcOffset(local - kSecondsPerDay) != offset || utcOffset(local + kSecondsPerDay) != offset) {
+        struct tm t;
+        time_t at = static_cast<time_t>(local);
+        gmtime_r(&at, &t);
+        t.tm_isdst = -1;
+        *us = static_cast<int64_t>(mktime(&t)) * 1000000;
+        return true;
+    }
+    *us = (local - offset) * 1000000;
+    return true;
+}
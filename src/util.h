@@ -1,5 +1,34 @@
 #ifndef  GRAPH_UTIL_H_
 #define GRAPH_UTIL_H_
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <unordered_map>
+// Terminal columns taken by UTF-8 text, or -1 if it is not valid UTF-8.
+// Printable ASCII runs are counted a vector at a time; other code points are
+// looked up in width_table.h.
 int getStrWidth(const char* s);
-void formatTime(char* buf, int size, struct tm* t);
+int getStrWidth(const char* s, size_t n);
+
+// getStrWidth for columns that repeat the same values, such as the work of
+// each event: widths of non-ASCII strings are remembered.
+class StrWidthCache {
+public:
+    int Width(const char* s, size_t n);
+
+    int Width(const std::string& s) { return Width(s.data(), s.size()); }
+
+private:
+    std::string key_;
+    std::unordered_map<std::string, int> widths_;
+};
+
+// Times are microseconds since the epoch and become local time only here.
+int64_t nowMicros();
+// Writes us as local "2006-01-02 15:04:05" and returns its length, 0 if it
+// does not fit in size.
+int formatTime(char* buf, int size, int64_t us);
+// Parses local "2006-01-02 15:04:05"; false if s is not exactly that layout.
+bool parseTime(const char* s, int64_t* us);
 #endif
\ No newline at end of file